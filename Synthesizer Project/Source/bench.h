@@ -0,0 +1,91 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "synth.h"
+#include "kernels.h"
+
+#ifndef BENCH_H
+#define BENCH_H
+
+/*
+this header renders a fixed heavy workload through the engine without any audio device,
+once for every kernel set the cpu can run, and prints how many times faster than realtime
+each one is so builds and machines can be compared
+
+it is also the workload the profile guided build is trained on, so it should keep
+exercising the paths the synth spends its time in when it's played
+*/
+
+#define BENCH_SAMPLE_RATE 44100
+#define BENCH_BLOCK 1024 // the same block size the audio thread uses
+#define BENCH_SECONDS 20.0 // how much audio is rendered for each kernel set
+#define BENCH_NOTES 8
+
+// renders the workload with a kernel set on a new synth, returns how many times faster than realtime it ran
+static inline double bench_render(const Kernels *set, double *out, int *converted){
+
+    // the chord held through the benchmark
+    const char keys[BENCH_NOTES] = { 48, 55, 60, 64, 67, 71, 74, 79 };
+
+    Synth *s = synth_create(BENCH_SAMPLE_RATE, BENCH_NOTES + 1);
+    if(s == NULL)
+        return 0.0;
+    s->kernels = *set;
+
+    // a sustained fm patch with full unison, the heaviest the synth is normally played with
+    s->params.carrier = OSC_SINE;
+    s->params.mod = OSC_TRIANGLE;
+    s->params.modDepth = 1.5;
+    s->params.detune = 1.0;
+    s->params.unisonVoices = 5;
+    s->params.attackTime = 0.1;
+    s->params.decayTime = 0.2;
+    s->params.sustainAmp = 0.3;
+    s->params.releaseTime = 1.0;
+    s->params.peak = 0.5;
+
+    for(int i = 0; i < BENCH_NOTES; i++)
+        synth_note_on(s, keys[i], 1.0);
+
+    unsigned int blockNum = (unsigned int)(BENCH_SECONDS * BENCH_SAMPLE_RATE / BENCH_BLOCK);
+
+    clock_t start = clock();
+    for(unsigned int i = 0; i < blockNum; i++){
+        synth_render(s, out, BENCH_BLOCK);
+        set->mix(out, converted, BENCH_BLOCK);
+    }
+    double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    synth_destroy(s);
+
+    double rendered = (double)blockNum * BENCH_BLOCK / BENCH_SAMPLE_RATE;
+    return rendered / fmax(seconds, 1e-9);
+}
+
+// runs the benchmark with every kernel set and selects the fastest
+static inline void bench_run(){
+
+    double *out = malloc(BENCH_BLOCK * sizeof(double));
+    int *converted = malloc(BENCH_BLOCK * sizeof(int));
+
+    printf("Rendering %d notes with 5 voices for %.0f seconds\n", BENCH_NOTES, BENCH_SECONDS);
+
+    int best = 0;
+    double bestSpeed = 0.0;
+    for(int i = 0; i < kernelSetNum; i++){
+        double speed = bench_render(&kernelSets[i], out, converted);
+        printf("%-8s %.1fx realtime\n", kernelSets[i].name, speed);
+        if(speed > bestSpeed){
+            bestSpeed = speed;
+            best = i;
+        }
+    }
+
+    kernels = kernelSets[best];
+    printf("Kernels Selected: %s\n", kernels.name);
+
+    free(out);
+    free(converted);
+}
+
+#endif //BENCH_H
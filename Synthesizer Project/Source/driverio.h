@@ -1,4 +1,12 @@
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN // keeps the old winsock out of windows.h so server.h can use winsock 2
 #include <windows.h>
+#include <mmsystem.h>
+#include <semaphore.h>
+#elif !defined(SYNTH_NO_ALSA)
+#include <alsa/asoundlib.h>
+#endif
+#include <errno.h>
 #include <string.h>
 #include <stdbool.h>
 #include <stdatomic.h>
@@ -6,54 +14,70 @@
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <semaphore.h>
+#include "kernels.h"
+#include "global.h"
+
+#ifndef DRIVERIO_H
+#define DRIVERIO_H
 
 /*
  This header file manages the interactions between the program and the sound card
-using the windows multimedia framework/waveOut API
+using the windows multimedia framework/waveOut API, or ALSA on linux
 
 a seperate thread is opened for the generation of samples and the processing of
-those samples.
+those samples, samples are generated a block at a time.
 */
 
 // Audio playback data
-unsigned int sampleRate;
-unsigned int channels;
-unsigned int blocks;
-unsigned int samples;
-unsigned int current;
+SYNTH_GLOBAL unsigned int sampleRate;
+SYNTH_GLOBAL unsigned int channels;
+SYNTH_GLOBAL unsigned int blocks;
+SYNTH_GLOBAL unsigned int samples;
+SYNTH_GLOBAL unsigned int current;
 
 // Waveform block buffers
-int *blockMemory;
-WAVEHDR *waveHeaders;
+SYNTH_GLOBAL int *blockMemory;
+SYNTH_GLOBAL double *mixBuffer; // the block generated by the user defined function before it's converted for the sound card
 
 // Device info
-char** devices;
-int devId;
-unsigned int deviceNum;
-WAVEOUTCAPS woc; // Wave Out Device Capabilities
+SYNTH_GLOBAL char** devices;
+SYNTH_GLOBAL int devId;
+SYNTH_GLOBAL unsigned int deviceNum;
+
+#ifdef _WIN32
+SYNTH_GLOBAL WAVEHDR *waveHeaders;
+SYNTH_GLOBAL WAVEOUTCAPS woc; // Wave Out Device Capabilities
 
 // Wave Out Device Windows Handle
-HWAVEOUT hwo;
+SYNTH_GLOBAL HWAVEOUT hwo;
+#elif !defined(SYNTH_NO_ALSA)
+// ALSA playback handle
+SYNTH_GLOBAL snd_pcm_t *pcm;
+#endif
 
-// User defined function pointer for multithreading
-double (*noiseFunc)();
+// User defined function pointer for multithreading, fills a block of samples
+SYNTH_GLOBAL void (*noiseFunc)(void*, double*, unsigned int);
+SYNTH_GLOBAL void *noiseData; // passed to the user defined function, such as the synth it renders
 
 // Atomic Variables for audio thread
-_Atomic bool ready;
-_Atomic double globalTime;
-sem_t blockFree; // Posix Semaphore, counts up atomically
+SYNTH_GLOBAL _Atomic bool ready;
+SYNTH_GLOBAL pthread_t audioThread;
+#ifdef _WIN32
+SYNTH_GLOBAL sem_t blockFree; // Posix Semaphore, counts up atomically
+#endif
 
 typedef enum DRIVER_ERROR{
     ERR_NO_DEVS, // No valid output devices
     ERR_INV_DEV, // Device selected is invalid
     ERR_NO_NOISE_FUNC, // No user function defined
     ERR_WAVEOUT_FAIL,
+    ERR_ALSA_FAIL,
     ERR_THREAD_FAIL,
 } DRIVER_ERROR;
 
+#ifdef _WIN32
 // Error handling for waveOut Functions
-void wave_error(MMRESULT *wavErr){
+static inline void wave_error(MMRESULT *wavErr){
     switch(*wavErr){
         case MMSYSERR_ALLOCATED : printf("Wave Error: Specified resource is already allocated\n"); return;
         case MMSYSERR_BADDEVICEID : printf("Wave Error: Specified device identifier is out of range\n"); return;
@@ -67,9 +91,15 @@ void wave_error(MMRESULT *wavErr){
         case WAVERR_STILLPLAYING : printf("Wave Error: There are still buffers in the queue\n"); return;
     }
 }
+#elif !defined(SYNTH_NO_ALSA)
+// Error handling for ALSA Functions
+static inline void alsa_error(int *alsaErr){
+    printf("ALSA Error: %s\n", snd_strerror(*alsaErr));
+}
+#endif
 
 // error handling for pthread Functions
-void thread_error(int *pthreadErr){
+static inline void thread_error(int *pthreadErr){
     
     switch(*pthreadErr){
         case EAGAIN : printf("Thread Error: The system lacked the necessary resources to create another thread, or the system-imposed limit on the total number of threads in a process PTHREAD_THREADS_MAX would be exceeded\n"); return;
@@ -82,7 +112,7 @@ void thread_error(int *pthreadErr){
 }
 
 // called when an error is thrown
-void throw_error(DRIVER_ERROR err, void *param){
+static inline void throw_error(DRIVER_ERROR err, void *param){
     
     switch(err){
         case ERR_NO_DEVS : printf("No Valid Audio Output Devices\n");
@@ -93,14 +123,75 @@ void throw_error(DRIVER_ERROR err, void *param){
         break;
         case ERR_THREAD_FAIL : thread_error((int*)param);
         break;
+#ifdef _WIN32
         case ERR_WAVEOUT_FAIL : wave_error((MMRESULT*)param);
         break;
+#elif !defined(SYNTH_NO_ALSA)
+        case ERR_ALSA_FAIL : alsa_error((int*)param);
+        break;
+#endif
+        default : break;
     }
     exit(1);
 }
 
+// set the parameters for sending sound data, 44.1khz is standard, channels describes mono or stereo sound
+static inline void set_wav_params(int _sampleRate, int _blocks, int _samples){
+    sampleRate = _sampleRate;
+#ifdef _WIN32
+    channels = woc.wChannels;
+#else
+    channels = 1; // the engine generates mono blocks
+#endif
+    blocks = _blocks;
+    samples = _samples;
+    printf("Parameters Set Successfully\n");
+}
+
+// set user defined function to generate blocks of samples for the audio thread, data is passed to every call
+static inline void set_noise_func(void(*func)(void*, double*, unsigned int), void *data){
+    noiseFunc = func;
+    noiseData = data;
+    printf("Set Noise Function Sucessfully\n");
+}
+
+// clip samples to ensure they don't go past 1 or -1
+static inline double clip(double sample, double max){
+    
+    if(sample >= 0.0)
+        return fmin(sample, max);
+    else
+        return fmax(sample, -max);
+    
+}
+
+/*
+ generates a block of samples by calling the user defined function, the block is
+clipped to ensure it stays within the bounds of -1 to 1 and then normalized to the
+integer domain because the sound drivers handle data within the integer domain
+*/
+static inline void audio_render_block(int *block){
+    
+    // if the user defined function has not been set throw an error
+    if(noiseFunc == NULL)
+        throw_error(ERR_NO_NOISE_FUNC, NULL);
+    
+    noiseFunc(noiseData, mixBuffer, samples);
+    
+    kernels.mix(mixBuffer, block, samples);
+}
+
+// stops the audio thread after the block it is generating, once this returns the user defined function is no longer called
+static inline void audio_stop(){
+    if(!ready)
+        return;
+    ready = false;
+    pthread_join(audioThread, NULL);
+}
+
+#ifdef _WIN32
 // Gets a list of all valid output devices and displays them to the screen, throws error if no devices
-void audio_init_devs(){
+static inline void audio_init_devs(){
     
     deviceNum = waveOutGetNumDevs();
     
@@ -122,7 +213,7 @@ void audio_init_devs(){
 }
 
 // Select an output device to output sound data to
-void set_output_device(int id){
+static inline void set_output_device(int id){
     // throw error if selected device id doesn't exist
     if(id > deviceNum || id < 0){
         throw_error(ERR_INV_DEV, NULL);
@@ -134,33 +225,8 @@ void set_output_device(int id){
     }
 }
 
-// set the parameters for sending sound data, 44.1khz is standard, channels describes mono or stereo sound
-void set_wav_params(int _sampleRate, int _blocks, int _samples){
-    sampleRate = _sampleRate;
-    channels = woc.wChannels;
-    blocks = _blocks;
-    samples = _samples;
-    printf("Parameters Set Successfully\n");
-}
-
-// set user defined function to generate samples for the audio thread
-void set_noise_func(double(*func)()){
-    noiseFunc = func;
-    printf("Set Noise Function Sucessfully\n");
-}
-
-// clip samples to ensure they don't go past 1 or -1
-double clip(double sample, double max){
-    
-    if(sample >= 0.0)
-        return fmin(sample, max);
-    else
-        return fmax(sample, -max);
-    
-}
-
 // This is a windows callback function which is called whenever the sound card is ready to recieve more data
-void CALLBACK waveOutProc(HWAVEOUT hwo, UINT uMsg, DWORD_PTR dwInstance, DWORD_PTR dwParam1,DWORD_PTR dwParam2){
+static inline void CALLBACK waveOutProc(HWAVEOUT hwo, UINT uMsg, DWORD_PTR dwInstance, DWORD_PTR dwParam1,DWORD_PTR dwParam2){
     
     /*
  uMsg can contain an enum which describes the state of the callback function,
@@ -179,19 +245,11 @@ if the callback function isn't in a state to recieve data we return from it
 }
 
 // This is a seperate thread which handles the creation and handling of samples, runs asynchronously
-void *audio_thread(void *args){
+static inline void *audio_thread(void *args){
     
     // Confirm the thread has opened
     printf("Thread Opened\n");
     
-    // instantiate global time counter
-    globalTime = 0;
-    // set how much the timer increments by every iteration of the thread loop
-    double timeStep = 1.0 / (double)sampleRate;
-    
-    // instantiate the sample value
-    int sample = 0;
-    
     // Loop until closed
     while(ready){
         
@@ -212,34 +270,8 @@ void *audio_thread(void *args){
             }
         }
         
-        // instantiate the new sample
-        int newSample = 0;
-        // get the current block the sample is in
-        int currentBlock = current * samples;
-        // for every sample within the block
-        for(unsigned int i = 0; i < samples; i++){
-            // if the user defined function has been set
-            if(noiseFunc != NULL){
-                /*
- generate a new sample by calling the user defined function
-clip it to ensure it stays within the bounds of -1 to 1 and
-then normalize it to the integer domain because the sound
-drivers handle data within the integer domain
-*/
-                newSample = (int)(clip(noiseFunc(), 1.0) * INT_MAX); 
-            } 
-            // if the user defined function has not been set throw an error
-            else{
-                throw_error(ERR_NO_NOISE_FUNC, NULL);
-            }
-            
-            // in the block memory set the current sample in the block to the newsample
-            blockMemory[currentBlock + i] = newSample;
-            // set the previous sample to the newsample
-            sample = newSample;
-            // increment globalTime
-            globalTime = globalTime + timeStep;
-        }
+        // generate the block and write it into the block memory
+        audio_render_block(blockMemory + current * samples);
         
         // prepare the waveheader
         MMRESULT prepResult = waveOutPrepareHeader(hwo, &waveHeaders[current], sizeof(WAVEHDR));
@@ -262,17 +294,17 @@ drivers handle data within the integer domain
         current %= blocks;
         
     }
+    return NULL;
 }
 
 // this function initializes all the necessarry values to ensure the audio thread can generate sound samples
-void audio_init(){
+static inline void audio_init(){
     
     // initialize values to 0/NULL
     ready = false; 
     current = 0;
     blockMemory = NULL;
     waveHeaders = NULL;
-    noiseFunc = NULL;
     
     // initialize the semaphore to the block amount
     int semInitResult = sem_init(&blockFree, 0, blocks);
@@ -299,6 +331,7 @@ void audio_init(){
     
     // allocate memory for two buffers which handle the samples and the waveheaders linked to them
     blockMemory = calloc(blocks * samples, sizeof(int));
+    mixBuffer = calloc(samples, sizeof(double));
     waveHeaders = calloc(blocks, sizeof(WAVEHDR));
     
     // for every block link a waveheader to it
@@ -310,18 +343,159 @@ void audio_init(){
     ready = true;
     
     // create a new thread
-    pthread_t thread;
     int iret;
-    iret = pthread_create(&thread, NULL, &audio_thread, NULL);
+    iret = pthread_create(&audioThread, NULL, &audio_thread, NULL);
     // if creating the new thread fails throw an error
     if(iret != 0)
         throw_error(ERR_THREAD_FAIL, &iret);
     
 }
 
-#ifndef DRIVERIO_H
-#define DRIVERIO_H
+#elif defined(SYNTH_NO_ALSA)
+
+// built without the ALSA headers (see the Makefile), there's nothing to play through
+static inline void audio_init_devs(){
+    deviceNum = 0;
+    printf("Built without ALSA, audio output isn't available\n");
+    throw_error(ERR_NO_DEVS, NULL);
+}
+
+static inline void set_output_device(int id){
+    throw_error(ERR_INV_DEV, NULL);
+}
+
+static inline void audio_init(){
+    throw_error(ERR_NO_DEVS, NULL);
+}
+
+#else
+
+// Gets a list of all valid ALSA output devices and displays them to the screen, throws error if no devices
+static inline void audio_init_devs(){
+    
+    void **hints;
+    int result = snd_device_name_hint(-1, "pcm", &hints);
+    if(result < 0)
+        throw_error(ERR_ALSA_FAIL, &result);
+    
+    // count the devices so the list can be allocated
+    unsigned int hintNum = 0;
+    while(hints[hintNum] != NULL)
+        hintNum++;
+    
+    devices = malloc((hintNum + 1) * sizeof(char*));
+    deviceNum = 0;
+    
+    // the default device follows the user's ALSA configuration, so it's listed first and played through unless another is chosen
+    devices[deviceNum] = strdup("default");
+    printf("%d. %s\n", deviceNum, devices[deviceNum]);
+    deviceNum++;
+    
+    for(unsigned int i = 0; i < hintNum; i++){
+        char *name = snd_device_name_get_hint(hints[i], "NAME");
+        char *ioid = snd_device_name_get_hint(hints[i], "IOID");
+        
+        // devices without an IOID can be used for input and output, the null device throws the sound away
+        if(name != NULL && (ioid == NULL || strcmp(ioid, "Output") == 0) && strcmp(name, "null") != 0 && strcmp(name, "default") != 0){
+            printf("%d. %s\n", deviceNum, name);
+            devices[deviceNum] = name;
+            deviceNum++;
+        }
+        else{
+            free(name);
+        }
+        free(ioid);
+    }
+    snd_device_name_free_hint(hints);
+    
+    if(deviceNum == 0){
+        throw_error(ERR_NO_DEVS, NULL);
+    }
+}
+
+// Select an output device to output sound data to
+static inline void set_output_device(int id){
+    // throw error if selected device id doesn't exist
+    if(id >= (int)deviceNum || id < 0){
+        throw_error(ERR_INV_DEV, NULL);
+    }
+    else{
+        devId = id; // set output device
+        printf("Output Device Selected\n");
+    }
+}
+
+// This is a seperate thread which handles the creation and handling of samples, runs asynchronously
+static inline void *audio_thread(void *args){
+    
+    // Confirm the thread has opened
+    printf("Thread Opened\n");
+    
+    // Loop until closed
+    while(ready){
+        
+        // generate the block and write it into the block memory
+        int *block = blockMemory + current * samples;
+        audio_render_block(block);
+        
+        // write the block to the sound card, this blocks until there is room in the device's buffer
+        snd_pcm_uframes_t left = samples;
+        while(left > 0){
+            snd_pcm_sframes_t written = snd_pcm_writei(pcm, block + (samples - left), left);
+            if(written < 0){
+                // recover from underruns, throw an error for anything else
+                int result = snd_pcm_recover(pcm, (int)written, 1);
+                if(result < 0)
+                    throw_error(ERR_ALSA_FAIL, &result);
+                continue;
+            }
+            left -= written;
+        }
+        
+        // increment the current block
+        current++;
+        // ensure that blocks loop when it goes past the max value of blocks
+        current %= blocks;
+        
+    }
+    return NULL;
+}
 
+// this function initializes all the necessarry values to ensure the audio thread can generate sound samples
+static inline void audio_init(){
+    
+    // initialize values to 0/NULL
+    ready = false; 
+    current = 0;
+    blockMemory = NULL;
+    
+    // attempt to open the device for playback
+    int result = snd_pcm_open(&pcm, devices[devId], SND_PCM_STREAM_PLAYBACK, 0);
+    if(result < 0)
+        throw_error(ERR_ALSA_FAIL, &result);
+    
+    // the same format as the waveOut driver, the latency is the length of all the blocks
+    unsigned int latency = (unsigned int)((double)blocks * samples * 1000000.0 / sampleRate);
+    result = snd_pcm_set_params(pcm, SND_PCM_FORMAT_S32, SND_PCM_ACCESS_RW_INTERLEAVED, channels, sampleRate, 1, latency);
+    if(result < 0)
+        throw_error(ERR_ALSA_FAIL, &result);
+    
+    // allocate memory for the samples
+    blockMemory = calloc(blocks * samples, sizeof(int));
+    mixBuffer = calloc(samples, sizeof(double));
+    
+    // set the thread to loop
+    ready = true;
+    
+    // create a new thread
+    int iret;
+    iret = pthread_create(&audioThread, NULL, &audio_thread, NULL);
+    // if creating the new thread fails throw an error
+    if(iret != 0)
+        throw_error(ERR_THREAD_FAIL, &iret);
+    
+}
 
+#endif
 
 #endif //DRIVERIO_H
@@ -1,4 +1,6 @@
 #include "note.h"
+#include "params.h"
+#include "kernels.h"
 
 #ifndef ENVELOPE_H
 #define ENVELOPE_H
@@ -12,59 +14,55 @@ the attack is how long it takes to reach it's loudest volume once it's played
 the decay  is how long it takes to go from the peak volume to the sustain volume
 the sustain volume is how loud the instrument is when the note is held
  the release is how long it takes for the sound to slowly dissipate to nothing once the note is released
+the times and volumes are held in the synth's parameters
 */
-double attackTime;
-double decayTime;
-double sustainAmp;
-double releaseTime;
-double peak;
 
-// this function applies an ADSR Envelope to the volume of a wave
-double envelope_apply(Note *n){
+// this function applies an ADSR Envelope to the volume of a wave at a time
+static inline double envelope_apply(const SynthParams *p, Note *n, double time){
     
     double returnAmp = 0.0; // the return value once the volume is calculated
     double releaseAmp = 0.0; // the volume caluclated once the note is released
     
     // if the note is being played
-    if(n->on > n->off){
+    if(!n->released){
         // get how long the note has been held for
-        double lifetime = globalTime - n->on;
+        double lifetime = time - n->on;
         // if the lifetime of the note is in the attack phase
-        if(lifetime <= attackTime){
-            returnAmp = (lifetime / attackTime) * peak; // slowly increase to peak
+        if(lifetime <= p->attackTime){
+            returnAmp = (lifetime / p->attackTime) * p->peak; // slowly increase to peak
         }
         
         // if the lifetime of the note is in the decay phase
-        if(lifetime > attackTime && lifetime <= (decayTime + attackTime)){
+        if(lifetime > p->attackTime && lifetime <= (p->decayTime + p->attackTime)){
             // Slowly decrease from peak towards sustain amplitude
-            returnAmp = ((lifetime - attackTime) / decayTime) * (sustainAmp - peak) + peak;
+            returnAmp = ((lifetime - p->attackTime) / p->decayTime) * (p->sustainAmp - p->peak) + p->peak;
         }
         
         // if the lifetime of the note is in the sustain phase
-        if(lifetime > (attackTime + decayTime)){
-            returnAmp = sustainAmp; // keep the volume at a consistent level
+        if(lifetime > (p->attackTime + p->decayTime)){
+            returnAmp = p->sustainAmp; // keep the volume at a consistent level
         }
     }
     // if the note has been released
-    if(n->off > n->on){
+    else{
         // get how long the note was played for
         double lifetime = n->off - n->on;
         // if the note was released in the attack phase
-        if(lifetime <= attackTime){
-            releaseAmp = (lifetime / attackTime) * peak; // get amp during attack phase
+        if(lifetime <= p->attackTime){
+            releaseAmp = (lifetime / p->attackTime) * p->peak; // get amp during attack phase
         }
         
         // if the note was released in the decay phase
-        if(lifetime > attackTime && lifetime <= (decayTime + attackTime)){
-            releaseAmp = ((lifetime - attackTime) / decayTime) * (sustainAmp - peak) + peak; // get amp during decay
+        if(lifetime > p->attackTime && lifetime <= (p->decayTime + p->attackTime)){
+            releaseAmp = ((lifetime - p->attackTime) / p->decayTime) * (p->sustainAmp - p->peak) + p->peak; // get amp during decay
         }
         
         // if the note was released in the sustain phase
-        if(lifetime > (attackTime + decayTime)){
-            releaseAmp = sustainAmp; // get amp from sustainAmp
+        if(lifetime > (p->attackTime + p->decayTime)){
+            releaseAmp = p->sustainAmp; // get amp from sustainAmp
         }
         // calculate the slow decay of the volume
-        returnAmp = ((globalTime - n->off) / releaseTime) * (-releaseAmp) + releaseAmp;
+        returnAmp = ((time - n->off) / p->releaseTime) * (-releaseAmp) + releaseAmp;
     }
     
     // if the volume of the note is almost 0
@@ -72,10 +70,43 @@ double envelope_apply(Note *n){
         // set the value to 0
         returnAmp = 0.0;
         // if the note is released
-        if(n->off > n->on)
+        if(n->released)
             n->active = false; // flag the note to be removed
     }
     return returnAmp; // return volume
 }
 
+/*
+fills amp with the envelope of a note for every sample of a block starting at time,
+this gives the same volumes as calling envelope_apply on each sample but the loops are
+done by the kernels so they can be vectorized
+*/
+static inline void envelope_block(const SynthParams *p, const Kernels *k, Note *n, double *amp, unsigned int count, double time, double timeStep){
+
+    if(count == 0)
+        return;
+
+    // if the note is being played
+    if(!n->released){
+        k->envelopeHeld(amp, count, time, timeStep, n->on, p->attackTime, p->decayTime, p->sustainAmp, p->peak);
+        return;
+    }
+
+    // get the volume the note was released at
+    double lifetime = n->off - n->on;
+    double releaseAmp = 0.0;
+    if(lifetime <= p->attackTime)
+        releaseAmp = (lifetime / p->attackTime) * p->peak;
+    if(lifetime > p->attackTime && lifetime <= (p->decayTime + p->attackTime))
+        releaseAmp = ((lifetime - p->attackTime) / p->decayTime) * (p->sustainAmp - p->peak) + p->peak;
+    if(lifetime > (p->attackTime + p->decayTime))
+        releaseAmp = p->sustainAmp;
+
+    k->envelopeRelease(amp, count, time, timeStep, n->off, p->releaseTime, releaseAmp);
+
+    // the release only falls, so once the end of the block is silent the note has finished
+    if(amp[count - 1] == 0.0)
+        n->active = false; // flag the note to be removed
+}
+
 #endif //ENVELOPE_H
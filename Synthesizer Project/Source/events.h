@@ -0,0 +1,228 @@
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+#include <stdbool.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#ifndef EVENTS_H
+#define EVENTS_H
+
+/*
+this header is a queue of timestamped events (notes and parameter changes) which are sent
+to a synth on the audio thread from other threads, every synth has its own queue, each event is played on the first sample at or
+after its timestamp so events keep their timing within a block
+
+any thread can push events, pushes are serialized with a mutex so the threads sending
+events never interfere with each other, the audio thread is the only reader and never
+takes the lock so it can't be stalled by a sender
+
+events can be sent ahead of time so the order they arrive in isn't the order they are due in,
+the audio thread moves them out of the queue into a pending list sorted by time, events due at
+the same time are played in the order they were sent
+
+inputs with their own timestamps (such as midi) stamp their events with the monotonic clock
+in events_now and convert the stamps to the synth's time with events_clock_to_time, the audio
+thread ties the two clocks together at the start of every block
+*/
+
+#define EVENT_QUEUE_SIZE 1024 // must be a power of 2
+
+// the types of events that can be sent to the audio thread
+enum SYNTH_EVENT{
+    EVENT_NOTE_ON = 1,
+    EVENT_NOTE_OFF = 2,
+    EVENT_PARAM = 3,
+    EVENT_CC = 4, // a midi controller, the id is the controller number and the value is from 0 to 1
+    EVENT_MOD_ROUTE = 5 // sets the amount of a modulation route, see synth_apply_event
+};
+
+// the parameters that can be changed with an event
+enum SYNTH_PARAM{
+    PARAM_DETUNE,
+    PARAM_MOD_DEPTH,
+    PARAM_CARRIER,
+    PARAM_MOD,
+    PARAM_ATTACK,
+    PARAM_DECAY,
+    PARAM_SUSTAIN,
+    PARAM_RELEASE,
+    PARAM_PEAK,
+    PARAM_VOICES,
+    PARAM_MOD_RATE, // samples per control block of the modulation matrix
+    PARAM_LFO1_RATE,
+    PARAM_LFO2_RATE,
+    PARAM_LFO3_RATE,
+    PARAM_LFO4_RATE,
+    PARAM_LFO1_SHAPE,
+    PARAM_LFO2_SHAPE,
+    PARAM_LFO3_SHAPE,
+    PARAM_LFO4_SHAPE,
+    PARAM_LFO1_RETRIGGER,
+    PARAM_LFO2_RETRIGGER,
+    PARAM_LFO3_RETRIGGER,
+    PARAM_LFO4_RETRIGGER
+};
+
+// structure which holds a single event
+typedef struct SynthEvent{
+    double time; // the time of the synth the event is played at
+    unsigned char type; // the SYNTH_EVENT type of the event
+    unsigned char id; // the key of a note event, the SYNTH_PARAM of a parameter event or the controller of a cc event
+    float value; // the new value of a parameter, controller or route, or the velocity of a note on
+} SynthEvent;
+
+// structure which holds the queue of a single synth
+typedef struct EventQueue{
+    SynthEvent events[EVENT_QUEUE_SIZE];
+    _Atomic unsigned int head; // the next event to be read by the audio thread
+    _Atomic unsigned int tail; // the next free space in the queue
+    pthread_mutex_t lock; // serializes the threads pushing events
+    _Atomic double clockOffset; // what is added to the monotonic clock to get the time events are played at
+    SynthEvent pending[EVENT_QUEUE_SIZE]; // events taken from the queue sorted by time, only used by the audio thread
+    int pendingStart; // the next pending event to be played
+    int pendingEnd; // the space after the last pending event
+} EventQueue;
+
+// instantiate the event queue
+static inline void events_init(EventQueue *q){
+    q->head = 0;
+    q->tail = 0;
+    pthread_mutex_init(&q->lock, NULL);
+    q->clockOffset = 0.0;
+    q->pendingStart = 0;
+    q->pendingEnd = 0;
+}
+
+// frees the resources held by the event queue
+static inline void events_free(EventQueue *q){
+    pthread_mutex_destroy(&q->lock);
+}
+
+// gets a monotonic time in seconds, for timestamping input and measuring how long blocks take
+static inline double events_now(){
+#ifdef _WIN32
+    LARGE_INTEGER count, frequency;
+    QueryPerformanceCounter(&count);
+    QueryPerformanceFrequency(&frequency);
+    return (double)count.QuadPart / (double)frequency.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+#endif
+}
+
+/*
+called by the audio thread as it starts generating a block, time is the synth's time at the
+start of the block, now is the monotonic time and latency is how long a block lasts
+
+input stamped while a block is being generated is too late for it, so stamps are moved a
+block later, every event is then delayed by the same amount instead of being pulled forward
+to the start of whichever block is next, which keeps the spacing between events
+*/
+static inline void events_sync_clock(EventQueue *q, double time, double now, double latency){
+    atomic_store_explicit(&q->clockOffset, time - now + latency, memory_order_relaxed);
+}
+
+// converts a monotonic timestamp from events_now into the time of the synth the event should be played at
+static inline double events_clock_to_time(EventQueue *q, double stamp){
+    return stamp + atomic_load_explicit(&q->clockOffset, memory_order_relaxed);
+}
+
+// adds a batch of events to the queue, returns false and adds nothing if there isn't space for all of them
+static inline bool events_push(EventQueue *q, const SynthEvent *events, int count){
+
+    pthread_mutex_lock(&q->lock);
+
+    unsigned int tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    unsigned int head = atomic_load_explicit(&q->head, memory_order_acquire);
+
+    // if the batch doesn't fit
+    if(tail - head + count > EVENT_QUEUE_SIZE){
+        pthread_mutex_unlock(&q->lock);
+        return false;
+    }
+
+    for(int i = 0; i < count; i++){
+        q->events[(tail + i) & (EVENT_QUEUE_SIZE - 1)] = events[i];
+    }
+    // publish the whole batch to the audio thread at once
+    atomic_store_explicit(&q->tail, tail + count, memory_order_release);
+
+    pthread_mutex_unlock(&q->lock);
+    return true;
+}
+
+// moves every event in the queue into the pending list in time order, only called from the audio thread
+static inline void events_drain(EventQueue *q){
+
+    unsigned int head = atomic_load_explicit(&q->head, memory_order_relaxed);
+    unsigned int tail = atomic_load_explicit(&q->tail, memory_order_acquire);
+
+    for(; head != tail; head++){
+
+        // move the pending events back to the start of the list when they reach the end
+        if(q->pendingEnd == EVENT_QUEUE_SIZE){
+            if(q->pendingStart == 0)
+                break; // the list is full, the rest wait in the queue
+            int count = q->pendingEnd - q->pendingStart;
+            memmove(q->pending, q->pending + q->pendingStart, count * sizeof(SynthEvent));
+            q->pendingStart = 0;
+            q->pendingEnd = count;
+        }
+
+        SynthEvent e = q->events[head & (EVENT_QUEUE_SIZE - 1)];
+
+        // most events arrive in order so the search starts from the end, events due at the same time keep their order
+        int i = q->pendingEnd;
+        while(i > q->pendingStart && q->pending[i - 1].time > e.time){
+            q->pending[i] = q->pending[i - 1];
+            i--;
+        }
+        q->pending[i] = e;
+        q->pendingEnd++;
+    }
+
+    // free the space for the senders
+    atomic_store_explicit(&q->head, head, memory_order_release);
+}
+
+// gets the time of the next event, returns false if there are no events, only called from the audio thread
+static inline bool events_peek(EventQueue *q, double *time){
+
+    events_drain(q);
+
+    if(q->pendingStart == q->pendingEnd)
+        return false;
+
+    *time = q->pending[q->pendingStart].time;
+    return true;
+}
+
+// gets the next event if it is due by the given time, only called from the audio thread
+static inline bool events_next(EventQueue *q, double time, SynthEvent *e){
+
+    events_drain(q);
+
+    // if there are no events
+    if(q->pendingStart == q->pendingEnd)
+        return false;
+
+    // if the next event isn't due yet
+    if(q->pending[q->pendingStart].time > time)
+        return false;
+
+    *e = q->pending[q->pendingStart];
+    q->pendingStart++;
+    if(q->pendingStart == q->pendingEnd){
+        q->pendingStart = 0;
+        q->pendingEnd = 0;
+    }
+    return true;
+}
+
+#endif //EVENTS_H
@@ -0,0 +1,19 @@
+#ifndef GLOBAL_H
+#define GLOBAL_H
+
+/*
+the engine is header only, its functions are static inline so the headers can be included from
+any number of source files without clashing
+
+the state shared by the whole program (the chosen kernels, the loaded samples, the sound card
+and the midi device) is declared with SYNTH_GLOBAL in every source file, and defined once in the
+source file which defines SYNTH_IMPLEMENTATION before it includes any of the headers
+*/
+
+#ifdef SYNTH_IMPLEMENTATION
+#define SYNTH_GLOBAL
+#else
+#define SYNTH_GLOBAL extern
+#endif
+
+#endif //GLOBAL_H
@@ -0,0 +1,177 @@
+#include <string.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "osc.h"
+#include "global.h"
+
+#ifndef KERNELS_H
+#define KERNELS_H
+
+/*
+this header holds the loops the audio thread spends most of its time in (the oscillators,
+the envelope and converting the mix for the sound card), written to work on a block of
+samples at a time so the compiler can vectorize them
+
+the loops are compiled once for each instruction set by including kernels_impl.h several
+times, and the fastest set the cpu supports is chosen when the program starts, so one
+build runs on old and new machines without being limited to the oldest instruction set
+
+the oscillators don't call sin() and asin() as the c library versions can't be vectorized,
+instead the phase is reduced to -pi..pi and sin is a polynomial, the triangle wave is the
+reduced phase folded at +/- pi/2 which is exactly what asin(sin(x)) gives
+*/
+
+#define KERNEL_PERIOD_HI 6.28318530717958623200 // 2 pi split in two so reducing large phases stays accurate
+#define KERNEL_PERIOD_LO 2.44929359829470635445e-16
+#define KERNEL_INV_PERIOD 0.15915494309189533577
+#define KERNEL_HALF_PI 1.57079632679489661923
+#define KERNEL_PI 3.14159265358979323846
+#define KERNEL_ROUND 6755399441055744.0 // adding and subtracting 1.5 * 2^52 rounds to the nearest whole number
+
+#define KERNEL_MAX_SETS 4 // generic, sse2 (only where it isn't the baseline), avx2 and avx512
+
+// reduces a phase to -pi..pi
+static inline __attribute__((always_inline)) double kernel_reduce(double x){
+    double n = (x * KERNEL_INV_PERIOD + KERNEL_ROUND) - KERNEL_ROUND;
+    return (x - n * KERNEL_PERIOD_HI) - n * KERNEL_PERIOD_LO;
+}
+
+// folds a reduced phase into -pi/2..pi/2 where sin is symmetric, this is also asin(sin(x))
+static inline __attribute__((always_inline)) double kernel_fold(double y){
+    if(y > KERNEL_HALF_PI)
+        return KERNEL_PI - y;
+    if(y < -KERNEL_HALF_PI)
+        return -KERNEL_PI - y;
+    return y;
+}
+
+// the taylor series of sin up to x^19, accurate to a few units in the last place within -pi/2..pi/2
+static inline __attribute__((always_inline)) double kernel_sin_poly(double x){
+    double x2 = x * x;
+    double p = -8.2206352466243297e-18;
+    p = p * x2 + 2.8114572543455208e-15;
+    p = p * x2 - 7.6471637318198164e-13;
+    p = p * x2 + 1.6059043836821613e-10;
+    p = p * x2 - 2.5052108385441720e-08;
+    p = p * x2 + 2.7557319223985893e-06;
+    p = p * x2 - 1.9841269841269841e-04;
+    p = p * x2 + 8.3333333333333333e-03;
+    p = p * x2 - 1.6666666666666667e-01;
+    return x + x * x2 * p;
+}
+
+// the oscillators in osc(), t is the global time of the sample for the square wave
+static inline __attribute__((always_inline)) double kernel_sine(double x, double t){
+    return kernel_sin_poly(kernel_fold(kernel_reduce(x)));
+}
+
+static inline __attribute__((always_inline)) double kernel_square(double x, double t){
+    return (kernel_sine(x, t) * t > 1) ? 1.0 : -1.0;
+}
+
+static inline __attribute__((always_inline)) double kernel_triangle(double x, double t){
+    return kernel_fold(kernel_reduce(x));
+}
+
+// oscillators osc() doesn't generate (such as the saw) are silent
+static inline __attribute__((always_inline)) double kernel_zero(double x, double t){
+    return 0.0;
+}
+
+// the kernels for a single instruction set
+typedef struct Kernels{
+    const char *name;
+    // adds a unison voice to out, see kernels_impl.h
+    void (*voice)(double *out, const double *amp, unsigned int count, double weight, double weightStep, double phase, double inc,
+                  double depth, double depthStep, enum OSC_TYPE car, enum OSC_TYPE md, double time, double timeStep);
+    // fills amp with the envelope of a held note
+    void (*envelopeHeld)(double *amp, unsigned int count, double time, double timeStep, double on,
+                         double attack, double decay, double sustain, double peak);
+    // fills amp with the envelope of a released note
+    void (*envelopeRelease)(double *amp, unsigned int count, double time, double timeStep, double off,
+                            double release, double releaseAmp);
+    // clips the mix and converts it into samples for the sound card
+    void (*mix)(const double *in, int *out, unsigned int count);
+} Kernels;
+
+SYNTH_GLOBAL Kernels kernels; // the fastest set, used by the sound card driver and given to every new synth
+SYNTH_GLOBAL Kernels kernelSets[KERNEL_MAX_SETS]; // every set this cpu can run, slowest first
+SYNTH_GLOBAL int kernelSetNum;
+// makes sure the kernels are only detected once, see kernels_init
+#ifdef SYNTH_IMPLEMENTATION
+pthread_once_t kernelsOnce = PTHREAD_ONCE_INIT;
+#else
+extern pthread_once_t kernelsOnce;
+#endif
+
+// stamp out the kernels for each instruction set, the generic set is built for whatever the compiler targets by default
+#define KERNEL(name) kernel_##name##_generic
+#define KERNEL_TARGET
+#include "kernels_impl.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+
+// sse2 is already the baseline on x86-64 (and on i386 built with -msse2), so the generic set is the sse2 set there
+#ifndef __SSE2__
+#define KERNEL(name) kernel_##name##_sse2
+#define KERNEL_TARGET __attribute__((target("sse2")))
+#include "kernels_impl.h"
+#endif
+
+#define KERNEL(name) kernel_##name##_avx2
+#define KERNEL_TARGET __attribute__((target("avx2")))
+#include "kernels_impl.h"
+
+#define KERNEL(name) kernel_##name##_avx512
+#define KERNEL_TARGET __attribute__((target("avx512f")))
+#include "kernels_impl.h"
+
+#endif
+
+// adds a kernel set to the list of sets this cpu can run
+static inline void kernels_add(Kernels set){
+    kernelSets[kernelSetNum] = set;
+    kernelSetNum++;
+}
+
+// selects a kernel set by name, returns false if the cpu can't run it
+static inline bool kernels_select(const char *name){
+    for(int i = 0; i < kernelSetNum; i++){
+        if(strcmp(kernelSets[i].name, name) == 0){
+            kernels = kernelSets[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+// finds the kernel sets this cpu supports and selects the fastest, see kernels_init
+static inline void kernels_detect(){
+
+    kernelSetNum = 0;
+    kernels_add((Kernels){ "generic", kernel_voice_generic, kernel_envelope_held_generic, kernel_envelope_release_generic, kernel_mix_generic });
+
+#if defined(__x86_64__) || defined(__i386__)
+    // checks the cpuid of the processor, and that the os saves the wider registers
+    __builtin_cpu_init();
+
+#ifndef __SSE2__
+    if(__builtin_cpu_supports("sse2"))
+        kernels_add((Kernels){ "sse2", kernel_voice_sse2, kernel_envelope_held_sse2, kernel_envelope_release_sse2, kernel_mix_sse2 });
+#endif
+    if(__builtin_cpu_supports("avx2"))
+        kernels_add((Kernels){ "avx2", kernel_voice_avx2, kernel_envelope_held_avx2, kernel_envelope_release_avx2, kernel_mix_avx2 });
+    if(__builtin_cpu_supports("avx512f"))
+        kernels_add((Kernels){ "avx512", kernel_voice_avx512, kernel_envelope_held_avx512, kernel_envelope_release_avx512, kernel_mix_avx512 });
+#endif
+
+    kernels = kernelSets[kernelSetNum - 1];
+}
+
+// finds the kernel sets once, every call after the first does nothing so any thread or synth can call it
+static inline void kernels_init(){
+    pthread_once(&kernelsOnce, kernels_detect);
+}
+
+#endif //KERNELS_H
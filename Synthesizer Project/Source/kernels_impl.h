@@ -0,0 +1,77 @@
+/*
+this file is included by kernels.h once for every instruction set, so it has no include guard
+KERNEL() gives each function the name of the instruction set and KERNEL_TARGET lets the
+compiler use that set's instructions when it vectorizes the loops
+*/
+
+// the loop of a unison voice for one carrier and modulating oscillator
+#define KERNEL_VOICE_LOOP(CARRIER, MODULATOR) \
+    for(unsigned int k = 0; k < count; k++){ \
+        double p = phase + k * inc; \
+        double t = time + k * timeStep; \
+        out[k] += amp[k] * (weight + k * weightStep) * CARRIER(p + (depth + k * depthStep) * MODULATOR(p, t), t); \
+    }
+
+// picks the loop for the modulating oscillator
+#define KERNEL_VOICE_MOD(CARRIER) \
+    switch(md){ \
+        case OSC_SINE: KERNEL_VOICE_LOOP(CARRIER, kernel_sine); break; \
+        case OSC_SQUARE: KERNEL_VOICE_LOOP(CARRIER, kernel_square); break; \
+        case OSC_TRIANGLE: KERNEL_VOICE_LOOP(CARRIER, kernel_triangle); break; \
+        default : KERNEL_VOICE_LOOP(CARRIER, kernel_zero); break; \
+    }
+
+/*
+adds a unison voice to out, the same as modulate() for every sample of the block
+phase is the phase of the voice at the first sample and steps by inc every sample,
+amp is the volume of each sample and weight is the volume of the voice within the unison,
+the weight and depth start at the first sample and ramp by their steps every sample (0 holds them)
+*/
+static inline KERNEL_TARGET void KERNEL(voice)(double *restrict out, const double *restrict amp, unsigned int count, double weight, double weightStep,
+                                 double phase, double inc, double depth, double depthStep, enum OSC_TYPE car, enum OSC_TYPE md,
+                                 double time, double timeStep){
+    switch(car){
+        case OSC_SINE: KERNEL_VOICE_MOD(kernel_sine); break;
+        case OSC_SQUARE: KERNEL_VOICE_MOD(kernel_square); break;
+        case OSC_TRIANGLE: KERNEL_VOICE_MOD(kernel_triangle); break;
+        default : break;
+    }
+}
+
+// the envelope of a held note at every sample of the block, the same as envelope_apply()
+static inline KERNEL_TARGET void KERNEL(envelope_held)(double *restrict amp, unsigned int count, double time, double timeStep, double on,
+                                         double attack, double decay, double sustain, double peak){
+    for(unsigned int k = 0; k < count; k++){
+        double lifetime = (time + k * timeStep) - on;
+        double a = sustain;
+        if(lifetime <= (decay + attack))
+            a = ((lifetime - attack) / decay) * (sustain - peak) + peak;
+        if(lifetime <= attack)
+            a = (lifetime / attack) * peak;
+        amp[k] = (a <= 0.001) ? 0.0 : a;
+    }
+}
+
+// the envelope of a released note at every sample of the block
+static inline KERNEL_TARGET void KERNEL(envelope_release)(double *restrict amp, unsigned int count, double time, double timeStep, double off,
+                                            double release, double releaseAmp){
+    for(unsigned int k = 0; k < count; k++){
+        double a = (((time + k * timeStep) - off) / release) * (-releaseAmp) + releaseAmp;
+        amp[k] = (a <= 0.001) ? 0.0 : a;
+    }
+}
+
+// clips the mix to -1..1 and converts it to the integer samples the sound drivers use
+static inline KERNEL_TARGET void KERNEL(mix)(const double *restrict in, int *restrict out, unsigned int count){
+    for(unsigned int k = 0; k < count; k++){
+        double s = in[k];
+        s = (s > 1.0) ? 1.0 : s;
+        s = (s < -1.0) ? -1.0 : s;
+        out[k] = (int)(s * INT_MAX);
+    }
+}
+
+#undef KERNEL_VOICE_MOD
+#undef KERNEL_VOICE_LOOP
+#undef KERNEL
+#undef KERNEL_TARGET
@@ -0,0 +1,129 @@
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include "note.h"
+
+#ifndef LOD_H
+#define LOD_H
+
+/*
+this header decides how much detail each note is rendered with (its level of detail)
+
+notes which are silent for a whole span aren't rendered at all, their voices are only
+stepped forward so they carry on in phase if they become audible again
+
+the audio thread measures how long each block takes to generate compared to how long it
+takes to play, when that gets close to the whole block the level of detail is raised and
+quiet or old notes are rendered with fewer unison voices, so a heavy passage loses some
+thickness on its background notes instead of the sound card running out of samples
+
+the audio thread never prints, changes of level are reported from the control thread by lod_report
+*/
+
+#define LOD_SILENT 0.001 // -60dB, the envelope already treats anything quieter as silence
+#define LOD_QUIET 0.05 // about -26dB, notes quieter than this are reduced first
+#define LOD_KEEP 2 // the newest notes which are kept at full detail until the last level
+#define LOD_MAX_LEVEL 3
+#define LOD_HIGH_LOAD 0.75 // raise the level when generating takes this much of a block's playing time
+#define LOD_LOW_LOAD 0.5 // lower it again once generating takes less than this
+#define LOD_RECOVER_BLOCKS 32 // how many light blocks in a row are needed before the level is lowered
+#define LOD_SMOOTHING 0.2 // how quickly the measured load follows each block
+
+// structure which holds the level of detail of a synth
+typedef struct Lod{
+    double load; // the smoothed fraction of a block's playing time spent generating it
+    _Atomic int level; // 0 renders every note in full, each level above drops more detail
+    int calm; // how many light blocks there have been in a row
+    int reported; // the last level printed by lod_report, only used by the control thread
+} Lod;
+
+// instantiate the level of detail at full detail
+static inline void lod_init(Lod *l){
+    l->load = 0.0;
+    l->level = 0;
+    l->calm = 0;
+    l->reported = 0;
+}
+
+// called by the audio thread after every block with how long it took to generate and how long it plays for
+static inline void lod_update(Lod *l, double elapsed, double duration){
+
+    l->load += (elapsed / duration - l->load) * LOD_SMOOTHING;
+    int level = atomic_load_explicit(&l->level, memory_order_relaxed);
+
+    if(l->load > LOD_HIGH_LOAD){
+        l->calm = 0;
+        if(level < LOD_MAX_LEVEL)
+            atomic_store_explicit(&l->level, level + 1, memory_order_relaxed);
+        return;
+    }
+
+    // wait for the load to stay low so the level doesn't flick back and forth
+    if(l->load < LOD_LOW_LOAD && level > 0){
+        l->calm++;
+        if(l->calm >= LOD_RECOVER_BLOCKS){
+            l->calm = 0;
+            atomic_store_explicit(&l->level, level - 1, memory_order_relaxed);
+        }
+    }
+    else
+        l->calm = 0;
+}
+
+// prints the level of detail if it has changed since the last call, called from the control thread
+static inline void lod_report(Lod *l){
+    int level = atomic_load_explicit(&l->level, memory_order_relaxed);
+    if(level == l->reported)
+        return;
+    printf("Level of Detail %s: %d\n", (level > l->reported) ? "Raised" : "Lowered", level);
+    l->reported = level;
+}
+
+/*
+gets how many unison voices of a note to render for a span, amp is the envelope of the span
+and age is how many notes were added after this one, 0 is the newest note
+
+level 1 reduces quiet and released notes to their centre voices, level 2 also reduces every
+note but the newest and drops quiet released notes down to one voice, level 3 stops
+rendering quiet released notes and reduces every note to its centre voices
+*/
+static inline int lod_voices(const Lod *l, const Note *n, const double *amp, unsigned int count, int age){
+
+    double loudest = 0.0;
+    for(unsigned int k = 0; k < count; k++)
+        loudest = (amp[k] > loudest) ? amp[k] : loudest;
+
+    // the note can't be heard for the whole span
+    if(loudest <= LOD_SILENT)
+        return 0;
+
+    int level = atomic_load_explicit(&l->level, memory_order_relaxed);
+    if(level == 0)
+        return n->voices;
+
+    // the one or two voices nearest the pitch of the note, which unison() keeps first
+    int centreVoices = (n->voices % 2 == 1) ? 1 : 2;
+    bool released = n->released;
+    bool quiet = loudest < LOD_QUIET;
+    bool old = age >= LOD_KEEP;
+
+    if(level >= 3){
+        if(quiet && released)
+            return 0;
+        return centreVoices;
+    }
+
+    if(level >= 2){
+        if(quiet && released)
+            return 1;
+        if(quiet || released || old)
+            return centreVoices;
+        return n->voices;
+    }
+
+    if(quiet || released)
+        return centreVoices;
+    return n->voices;
+}
+
+#endif //LOD_H
@@ -1,107 +1,175 @@
+#define SYNTH_IMPLEMENTATION // the state shared by the engine is defined in this file, see global.h
 #include "driverio.h"
 #include "midi.h"
-#include "notearray.h"
-#include "osc.h"
-#include "unison.h"
-#include "envelope.h"
+#include "synth.h"
+#include "server.h"
+#include "bench.h"
 
-// Controls the amount each voice is detuned by
-double detune;
-
-// Method called by the audio thread which generates a sample of a waveform to be sent to the sound drivers
-double generate_wave(){
+int main(int argc, char **argv){
     
-    double r = 0.0;
-    // For each note currently pressed
-    for(int i = 0; i < notesCurrent; i++){
-        // add the frequencies and waveforms of each note together to produce polyphony
-        r += unison(detune, 5, notes[i].f, 0.4, envelope_apply(&notes[i]));
-        // if the note is no longer producing sound remove it from the note list
-        if(notes[i].active == false)
-            note_remove(notes[i]);
+    /*
+Read the arguments, --server [port] runs the synth headless, --samples <list> loads a multisample
+for OSC_SAMPLE, --device <n> plays through the nth output device listed (0 by default), --bench times the engine without opening any devices, any others are the scala scale (.scl) and keyboard mapping (.kbm)
+*/
+    bool serverMode = false;
+    bool benchMode = false;
+    unsigned short port = SERVER_PORT;
+    int outputDevice = 0;
+    const char *samplePath = NULL;
+    const char *sclPath = NULL;
+    const char *kbmPath = NULL;
+    for(int i = 1; i < argc; i++){
+        if(strcmp(argv[i], "--server") == 0){
+            serverMode = true;
+            // the port is optional
+            if(i + 1 < argc && atoi(argv[i + 1]) > 0)
+                port = atoi(argv[++i]);
+        }
+        else if(strcmp(argv[i], "--bench") == 0)
+            benchMode = true;
+        else if(strcmp(argv[i], "--samples") == 0 && i + 1 < argc)
+            samplePath = argv[++i];
+        else if(strcmp(argv[i], "--device") == 0 && i + 1 < argc)
+            outputDevice = atoi(argv[++i]);
+        else if(sclPath == NULL)
+            sclPath = argv[i];
+        else
+            kbmPath = argv[i];
     }
-    // send this sample to the audio thread
-    return r;
-}
-
-int main(){
     
-    // Initialize Detune value to 0
-    detune = 0;
+#ifndef _WIN32
+    // the keyboard controls only work on windows, so on other platforms the synth is played through the server and midi
+    serverMode = true;
+#endif
+    
+    // Pick the fastest kernels the cpu can run, synth_create would otherwise do it for the first synth
+    kernels_init();
+    
+    if(benchMode){
+        bench_run();
+        return 0;
+    }
+    printf("Kernels Selected: %s\n", kernels.name);
     
     // Initialize Audio Data & Thread
     audio_init_devs();
-    set_output_device(0);
+    set_output_device(outputDevice);
     /*
 44100hz/44.1khz is the standard sample rate for most audio tools
 8 blocks with 1024 samples per block generates the best quality sound without sacraficing latency
 */
     set_wav_params(44100, 8, 1024);
+    
+    /*
+Create the synth with up to 9 notes at once, it starts in 12-TET at A440 with no detune, 5 voices per note,
+sine waves with no modulation and an envelope of 2 second attack, decay and release with a sustain of 0.3
+*/
+    Synth *synth = synth_create(sampleRate, 9);
+    if(synth == NULL){
+        printf("Unable to create the synth\n");
+        return 1;
+    }
+    
+    // Load the scala tuning if one was given
+    if(sclPath != NULL)
+        synth_load_scala(synth, sclPath, kbmPath);
+    
+    // Map the multisample and start paging it in ahead of the playheads
+    if(samplePath != NULL && sampler_load(samplePath) > 0 && !sampler_init())
+        return 1;
+    
     audio_init();
-    set_noise_func(generate_wave);
+    set_noise_func(synth_play, synth);
     
     // Initialize Midi Data & Thread
     midi_init_devs();
     set_midi_device(0);
-    midi_init();
+    midi_init(synth);
     
-    // Initialze Note List
-    notes_init(9);
-    
-    // Initialize Modulation Options
-    carrier = OSC_SINE;
-    mod = OSC_SINE;
-    modDepth = 0;
+    // In server mode the synth is controlled over the socket, this thread waits on it until told to quit
+    if(serverMode){
+        server_run(synth, port);
+        // stop generating before the samples are unmapped
+        audio_stop();
+        sampler_shutdown();
+        return 0;
+    }
     
-    // Initialize Envelope Options
-    attackTime = 2.0;
-    peak = 0.3;
-    decayTime = 2.0;
-    sustainAmp = 0.3;
-    releaseTime = 2.0;
+#ifdef _WIN32
+    // the synth's parameters are only changed on the audio thread, so the keys send changes to it and keep their own copies
+    double detune = 0.0;
+    double modDepth = 0.0;
     
     while(1){
+        // the audio thread can't print, so changes to the level of detail are reported here
+        lod_report(&synth->lod);
+        
         // Capture keyboard inputs from the user on a seperate thread to not disturb the audio thread
-        if(GetAsyncKeyState(VK_ESCAPE) & 0x01)
+        if(GetAsyncKeyState(VK_ESCAPE) & 0x01){
+            audio_stop();
+            sampler_shutdown();
             exit(0); // close the program
+        }
         
-        if(GetAsyncKeyState(VK_LEFT) & 0x01)
+        if(GetAsyncKeyState(VK_LEFT) & 0x01){
             detune += 0.2; 
+            synth_send_param(synth, PARAM_DETUNE, detune);
+        }
         
-        if(GetAsyncKeyState(VK_RIGHT) & 0x01)
+        if(GetAsyncKeyState(VK_RIGHT) & 0x01){
             detune -= 0.2;
+            synth_send_param(synth, PARAM_DETUNE, detune);
+        }
         
-        if(GetAsyncKeyState(VK_UP) & 0x01)
+        if(GetAsyncKeyState(VK_UP) & 0x01){
             modDepth += 0.1;
+            synth_send_param(synth, PARAM_MOD_DEPTH, modDepth);
+        }
         
-        if(GetAsyncKeyState(VK_DOWN) & 0x01)
+        if(GetAsyncKeyState(VK_DOWN) & 0x01){
             modDepth -= 0.1;
+            synth_send_param(synth, PARAM_MOD_DEPTH, modDepth);
+        }
         
         if(GetAsyncKeyState(VK_NUMPAD1) & 0x01)
-            carrier = OSC_SINE;
+            synth_send_param(synth, PARAM_CARRIER, OSC_SINE);
         
         if(GetAsyncKeyState(VK_NUMPAD2) & 0x01)
-            carrier = OSC_TRIANGLE;
+            synth_send_param(synth, PARAM_CARRIER, OSC_TRIANGLE);
         
         if(GetAsyncKeyState(VK_NUMPAD3) & 0x01)
-            carrier = OSC_SQUARE;
+            synth_send_param(synth, PARAM_CARRIER, OSC_SQUARE);
+        
+        if(GetAsyncKeyState(VK_NUMPAD7) & 0x01)
+            synth_send_param(synth, PARAM_CARRIER, OSC_SAMPLE);
         
         if(GetAsyncKeyState(VK_NUMPAD4) & 0x01)
-            mod = OSC_SINE;
+            synth_send_param(synth, PARAM_MOD, OSC_SINE);
         
         if(GetAsyncKeyState(VK_NUMPAD5) & 0x01)
-            mod = OSC_TRIANGLE;
+            synth_send_param(synth, PARAM_MOD, OSC_TRIANGLE);
         
         if(GetAsyncKeyState(VK_NUMPAD6) & 0x01)
-            mod = OSC_SQUARE;
+            synth_send_param(synth, PARAM_MOD, OSC_SQUARE);
+        // Switch back to 12-TET
+        if(GetAsyncKeyState(VK_F1) & 0x01)
+            synth_set_tuning(synth, tuning_create_tet(440.0, sampleRate));
+        
+        // Reload the scala tuning given as an argument
+        if((GetAsyncKeyState(VK_F2) & 0x01) && sclPath != NULL)
+            synth_load_scala(synth, sclPath, kbmPath);
+        
         // Reset all modifiers back to default
         if(GetAsyncKeyState(VK_BACK) & 0x01){
-            carrier = OSC_SINE;
-            mod = OSC_SINE;
             detune = 0.0;
             modDepth = 0.0;
+            synth_send_param(synth, PARAM_CARRIER, OSC_SINE);
+            synth_send_param(synth, PARAM_MOD, OSC_SINE);
+            synth_send_param(synth, PARAM_DETUNE, detune);
+            synth_send_param(synth, PARAM_MOD_DEPTH, modDepth);
         }
     }
+#endif
     
     return 0;
 }
\ No newline at end of file
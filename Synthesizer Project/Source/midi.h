@@ -1,10 +1,19 @@
+#ifdef _WIN32
 #include <windows.h>
+#include <mmsystem.h>
+#elif !defined(SYNTH_NO_ALSA)
+#include <alsa/asoundlib.h>
+#include <errno.h>
+#endif
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
 #include <pthread.h>
+#include <stdint.h>
+#include <string.h>
 #include <math.h>
-#include "notearray.h"
+#include "synth.h"
+#include "global.h"
 
 #ifndef MIDI_H
 #define MIDI_H
@@ -19,28 +28,122 @@ for instance a midi message can be comprised of a status byte which describes a
 being turned on, and the following data bytes will describe the specific note which was 
 pressed and how hard it was pressed.
 
-
-
+windows reads midi through the multimedia framework and linux through ALSA rawmidi on its
+own thread, either way every message is stamped with the time it arrived and sent through
+the event queue of the synth being played so it is played on the sample it was played on
+rather than at the start of the next block
 */
 
 // this is an enum which abstracts the status byte of a midi message
 enum midi_status{
     NOTE_OFF = 0x8,
-    NOTE_ON = 0x9
+    NOTE_ON = 0x9,
+    CONTROL_CHANGE = 0xB
 };
 
 // Midi Device Data
-char** midiDevices;
-int midiDevId;
+SYNTH_GLOBAL char** midiDevices;
+SYNTH_GLOBAL int midiDevId;
+SYNTH_GLOBAL unsigned int midiDeviceNum;
+
+// the state of a midi byte stream between reads
+typedef struct MidiParser{
+    unsigned char status; // the running status, 0 if there isn't one
+    unsigned char data[2];
+    int count; // how many data bytes have been read for the current message
+} MidiParser;
+
+// bitwise operation to get just the status bit from a midi message
+static inline enum midi_status midi_get_status_bit(uint32_t msg){
+    return (((1 << 4) - 1) & (msg >> (5 - 1)));
+}
+
+// this function gathers the first data bit from the midi message and converts it into a 1 byte character
+static inline char midi_get_note_num(uint32_t msg){
+    return (((1 << 8) - 1) & (msg >> (9 - 1)));
+}
 
+// gathers the second data byte from the midi message, the velocity of a note or the value of a controller
+static inline int midi_get_value(uint32_t msg){
+    return (msg >> 16) & 0x7F;
+}
+
+// copies the name of a device so it outlives the structure it was read from
+static inline char *midi_copy_name(const char *name){
+    size_t size = strlen(name) + 1;
+    char *copy = malloc(size);
+    memcpy(copy, name, size);
+    return copy;
+}
+
+// sends a midi message to a synth, stamp is the events_now() time the message arrived
+static inline void midi_handle(Synth *s, uint32_t msg, double stamp){
+    
+    SynthEvent e;
+    e.time = events_clock_to_time(&s->events, stamp);
+    e.id = midi_get_note_num(msg) & 0x7F;
+    e.value = midi_get_value(msg) / 127.0f;
+    
+    // check the status bit to see if the note is pressed or released
+    switch(midi_get_status_bit(msg)){
+        // if the note is pressed, a note on with no velocity is how many keyboards release a note
+        case NOTE_ON: e.type = (e.value > 0.0f) ? EVENT_NOTE_ON : EVENT_NOTE_OFF; break;
+        // if the note is released
+        case NOTE_OFF: e.type = EVENT_NOTE_OFF; break;
+        // if a controller is moved, for the modulation matrix
+        case CONTROL_CHANGE: e.type = EVENT_CC; break;
+        default : return;
+    }
+    
+    synth_send(s, &e, 1);
+}
+
+/*
+reads a byte from a midi stream, returns true and sets msg once a whole message has been read
+messages are packed the same way as windows packs them, status | data1 << 8 | data2 << 16
+*/
+static inline bool midi_parse_byte(MidiParser *p, unsigned char byte, uint32_t *msg){
+    
+    // real time messages (clock, active sensing) can come between any bytes and aren't used
+    if(byte >= 0xF8)
+        return false;
+    
+    // a status byte starts a new message, system messages (such as sysex) cancel the running status
+    if(byte & 0x80){
+        p->status = (byte < 0xF0) ? byte : 0;
+        p->count = 0;
+        return false;
+    }
+    
+    // data without a status, such as the body of a sysex message
+    if(p->status == 0)
+        return false;
+    
+    p->data[p->count] = byte;
+    p->count++;
+    
+    // program change and channel pressure have one data byte, the rest have two
+    int needed = ((p->status & 0xE0) == 0xC0) ? 1 : 2;
+    if(p->count < needed)
+        return false;
+    
+    *msg = p->status | ((uint32_t)p->data[0] << 8) | ((needed == 2) ? (uint32_t)p->data[1] << 16 : 0);
+    // the status is kept so the next message can leave it out
+    p->count = 0;
+    return true;
+}
+
+#ifdef _WIN32
 // Midi in handler variable
-HMIDIIN hmi;
+SYNTH_GLOBAL HMIDIIN hmi;
+SYNTH_GLOBAL double midiStartStamp; // the events_now() time the device was started, windows stamps messages in ms from then
 
 // gather all midi devices and display their ID and name
-void midi_init_devs(){
+static inline void midi_init_devs(){
     
     // get number of devices
     unsigned int numInDevs = midiInGetNumDevs();
+    midiDeviceNum = numInDevs;
     
     // allocate memory to a buffer which holds all device names
     midiDevices = malloc(numInDevs * sizeof(char*));
@@ -51,90 +154,176 @@ void midi_init_devs(){
     for(int i = 0; i < numInDevs; i++){
         // if devices are found
         if(midiInGetDevCaps(i, &minc, sizeof(MIDIINCAPS)) == S_OK){
-            midiDevices[i] = minc.szPname; // store name in midiDevices
+            midiDevices[i] = midi_copy_name(minc.szPname); // store name in midiDevices
             printf("%d. %s\n", i, minc.szPname); // print the name and ID
         }
     }
 }
 
 // set the midi device for input
-void set_midi_device(int id){
+static inline void set_midi_device(int id){
     midiDevId = id;
 }
 
-// bitwise operation to get just the status bit from a midi message
-enum midi_status midi_get_status_bit(DWORD msg){
-    return (((1 << 4) - 1) & (msg >> (5 - 1)));
-}
-
-// this function gathers the first data bit from the midi message and converts it into a 1 byte character
-char midi_get_note_num(DWORD msg){
-    return (((1 << 8) - 1) & (msg >> (9 - 1)));
-}
-
-// convert the character from the previous function into a notes frequency
-double midi_note_num_to_f(char key){
-    return 440 * pow(2, ((double)key - 69) / 12);
-}
-
 /*
 MidiInProc is a placeholder function that the midiInOpen function uses to perform functions
  whenever a new Midi In event is triggered.
 The function takes 5 parameters:
 * hMidiIn is the device that we're generating input from
 * wMsg defines the type of data that's being sent to the function (defines dwParams)
-* dwInstance is user instance data that we can pass through, such as a user defined struct
+* dwInstance is user instance data that we can pass through, the synth being played
 * dwParam1 is the MIDI Message format when wMsg = MIM_DATA
 * dwParam2 is the Timestamp when the midi message is sent
 dwParams are changed based on what wMsg is
 */
-void CALLBACK MidiInProc(HMIDIIN hMidiIn, UINT wMsg, DWORD dwInstance, DWORD dwParam1, DWORD dwParam2){
+static inline void CALLBACK MidiInProc(HMIDIIN hMidiIn, UINT wMsg, DWORD_PTR dwInstance, DWORD_PTR dwParam1, DWORD_PTR dwParam2){
     switch(wMsg){
         // in the case that uMsg shows that a new midi input has been detected
-        case MIM_DATA:{
+        case MIM_DATA: midi_handle((Synth*)dwInstance, (uint32_t)dwParam1, midiStartStamp + dwParam2 / 1000.0); break;
+        default : return;
+    }
+}
+
+// starts the midi thread, which plays a synth
+static inline void midi_init(Synth *s){
+    
+    if(midiDevId < 0 || midiDevId >= (int)midiDeviceNum){
+        printf("No Midi Input Device\n");
+        return;
+    }
+    
+    // opens the midi channel for input
+    if(midiInOpen(&hmi, midiDevId, (DWORD_PTR)MidiInProc, (DWORD_PTR)s, CALLBACK_FUNCTION) != MMSYSERR_NOERROR){
+        printf("Unable to open Midi Input Device\n");
+        return;
+    }
+    // starts the midi handler, the timestamps of messages start from here
+    midiStartStamp = events_now();
+    midiInStart(hmi);
+}
+
+#elif defined(SYNTH_NO_ALSA)
+
+// built without the ALSA headers (see the Makefile), there are no midi inputs
+static inline void midi_init_devs(){
+    midiDeviceNum = 0;
+    midiDevices = NULL;
+}
+
+// set the midi device for input
+static inline void set_midi_device(int id){
+    midiDevId = id;
+}
+
+// there's never a device to open, this only reports that
+static inline void midi_init(Synth *s){
+    printf("No Midi Input Device\n");
+}
+
+#else
+
+// ALSA rawmidi input handle
+SYNTH_GLOBAL snd_rawmidi_t *rawIn;
+
+// gather all midi input ports and display their ID and name
+static inline void midi_init_devs(){
+    
+    midiDeviceNum = 0;
+    midiDevices = NULL;
+    
+    // every card can have several rawmidi devices, each with several subdevices (ports)
+    int card = -1;
+    while(snd_card_next(&card) == 0 && card >= 0){
+        
+        char ctlName[32];
+        snprintf(ctlName, sizeof(ctlName), "hw:%d", card);
+        snd_ctl_t *ctl;
+        if(snd_ctl_open(&ctl, ctlName, 0) < 0)
+            continue;
+        
+        int device = -1;
+        while(snd_ctl_rawmidi_next_device(ctl, &device) == 0 && device >= 0){
             
-            // create a new note based off of the midi message
-            Note n;
-            n.id = midi_get_note_num(dwParam1); // get the note id
-            n.f = midi_note_num_to_f(n.id); // create a frequency from the id
-            n.active = true; // bool ensures the note won't be removed and will use Envelope system
-            n.on = globalTime; // get the time the note was turned on at
-            n.off = 0.0; // the time the note was turned off at (hasn't been turned off)
+            snd_rawmidi_info_t *info;
+            snd_rawmidi_info_alloca(&info);
+            snd_rawmidi_info_set_device(info, device);
+            snd_rawmidi_info_set_stream(info, SND_RAWMIDI_STREAM_INPUT);
+            snd_rawmidi_info_set_subdevice(info, 0);
             
-            // check if the note already exists within the note list
-            Note* found = note_get(n.id); 
+            // the device has no inputs
+            if(snd_ctl_rawmidi_info(ctl, info) < 0)
+                continue;
             
-            // check the status bit to see if the note is pressed or released
-            switch(midi_get_status_bit(dwParam1)){
-                // if the note is pressed
-                case NOTE_ON: {
-                    // if the note is not yet in the note list
-                    if(found == NULL)
-                        note_add(n); // add it to the list
-                    // if the note is already in the note list but not finished making noise
-                    else{
-                        found->on = globalTime; // reset the envelope
-                        found->active = true; // ensure it isn't removed from the notelist
-                    }
-                };
-                break;
-                // if the note is released
-                case NOTE_OFF: {
-                    found->off = globalTime; // set the note off time for the Envelope release phase
-                }; break;
-                default : break;
+            unsigned int subdevices = snd_rawmidi_info_get_subdevices_count(info);
+            for(unsigned int sub = 0; sub < subdevices; sub++){
+                snd_rawmidi_info_set_subdevice(info, sub);
+                if(snd_ctl_rawmidi_info(ctl, info) < 0)
+                    continue;
+                
+                char name[32];
+                snprintf(name, sizeof(name), "hw:%d,%d,%u", card, device, sub);
+                midiDevices = realloc(midiDevices, (midiDeviceNum + 1) * sizeof(char*));
+                midiDevices[midiDeviceNum] = midi_copy_name(name);
+                printf("%d. %s (%s)\n", midiDeviceNum, snd_rawmidi_info_get_subdevice_name(info), name);
+                midiDeviceNum++;
             }
-        };break;
-        default : return;
+        }
+        snd_ctl_close(ctl);
     }
 }
 
-// starts the midi thread
-void midi_init(){
-    // opens the midi channel for input
-    midiInOpen(&hmi, devId, (DWORD_PTR)MidiInProc, 0, CALLBACK_FUNCTION);
-    // starts the midi handler
-    midiInStart(hmi);
+// set the midi device for input
+static inline void set_midi_device(int id){
+    midiDevId = id;
+}
+
+// reads the midi device on its own thread, which sleeps in the read until bytes arrive so they are stamped straight away
+static inline void *midi_thread(void *args){
+    
+    Synth *s = args;
+    MidiParser parser = { 0, { 0, 0 }, 0 };
+    unsigned char buffer[256];
+    
+    while(1){
+        ssize_t size = snd_rawmidi_read(rawIn, buffer, sizeof(buffer));
+        // stamp the bytes as soon as they arrive
+        double stamp = events_now();
+        
+        if(size == -EAGAIN || size == -EINTR)
+            continue;
+        if(size < 0){
+            printf("Midi Error: %s\n", snd_strerror((int)size));
+            return NULL;
+        }
+        
+        for(ssize_t i = 0; i < size; i++){
+            uint32_t msg;
+            if(midi_parse_byte(&parser, buffer[i], &msg))
+                midi_handle(s, msg, stamp);
+        }
+    }
 }
 
+// opens the midi device and starts the midi thread, which plays a synth
+static inline void midi_init(Synth *s){
+    
+    if(midiDevId < 0 || midiDevId >= (int)midiDeviceNum){
+        printf("No Midi Input Device\n");
+        return;
+    }
+    
+    int result = snd_rawmidi_open(&rawIn, NULL, midiDevices[midiDevId], 0);
+    if(result < 0){
+        printf("Unable to open Midi Input Device: %s\n", snd_strerror(result));
+        return;
+    }
+    
+    pthread_t thread;
+    int iret = pthread_create(&thread, NULL, &midi_thread, s);
+    if(iret != 0)
+        printf("Unable to start Midi Thread\n");
+}
+
+#endif
+
 #endif //MIDI_H
@@ -0,0 +1,269 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <math.h>
+#include "note.h"
+#include "osc.h"
+#include "params.h"
+#include "unison.h"
+#include "kernels.h"
+
+#ifndef MODMATRIX_H
+#define MODMATRIX_H
+
+/*
+this header is a modulation matrix, a list of routes which each connect a source (an LFO,
+the note's envelope, its velocity or a midi controller) to a destination (the pitch,
+FM depth, detune, unison blend or volume of the note) by an amount
+
+every synth has its own matrix, the routes are worked out at a control rate rather than every sample, every rate samples
+each note finds the value of its destinations at the end of the next control block, the
+volume, FM depth and unison blend are ramped linearly from the previous values a sample at a
+time across the block, the pitch and detune are held at the middle of the ramp, which lands each
+voice on the same phase a full ramp would
+
+when there are no routes notes are rendered exactly as they were without the matrix
+*/
+
+#define MOD_MAX_LFOS 4
+#define MOD_MAX_ROUTES 16
+#define MOD_MAX_CCS 8 // how many midi controllers can be used as sources
+#define MOD_DEFAULT_RATE 32 // samples per control block
+#define MOD_MAX_RATE 256
+
+// the sources a route can read, packed into 4 bits so a route fits the id of an event
+enum MOD_SOURCE{
+    MOD_SRC_LFO1,
+    MOD_SRC_LFO2,
+    MOD_SRC_LFO3,
+    MOD_SRC_LFO4,
+    MOD_SRC_ENVELOPE, // the note's volume envelope, 0 to 1 of the peak
+    MOD_SRC_VELOCITY, // how hard the note was played, 0 to 1
+    MOD_SRC_CC1, // the midi controllers in modCCNumbers, 0 to 1
+    MOD_SRC_CC2,
+    MOD_SRC_CC3,
+    MOD_SRC_CC4,
+    MOD_SRC_CC5,
+    MOD_SRC_CC6,
+    MOD_SRC_CC7,
+    MOD_SRC_CC8,
+    MOD_SOURCES
+};
+
+// the destinations a route can change, the amounts are in the units of each destination
+enum MOD_DEST{
+    MOD_DEST_PITCH, // semitones
+    MOD_DEST_FM_DEPTH, // added to modDepth
+    MOD_DEST_DETUNE, // hz added to the note's detune
+    MOD_DEST_BLEND, // added to the volume of the blended unison voices
+    MOD_DEST_AMP, // fraction of the volume added, -1 silences the note
+    MOD_DESTS
+};
+
+_Static_assert(MOD_DESTS == NOTE_MOD_DESTS, "note.h holds the last value of every destination");
+
+// a low frequency oscillator, LFOs are shared by every note
+typedef struct Lfo{
+    enum OSC_TYPE shape; // sine, square, triangle or saw
+    double rate; // hz
+    bool retrigger; // start the LFO from the start of its cycle when each note is turned on
+} Lfo;
+
+// connects a source to a destination
+typedef struct ModRoute{
+    enum MOD_SOURCE source;
+    enum MOD_DEST dest;
+    double amount;
+} ModRoute;
+
+// structure which holds the matrix of a synth
+typedef struct ModMatrix{
+    Lfo lfos[MOD_MAX_LFOS];
+    ModRoute routes[MOD_MAX_ROUTES];
+    int routeNum;
+    unsigned int rate; // samples per control block
+    double cc[128]; // the latest value of every midi controller, 0 to 1
+    int ccNumbers[MOD_MAX_CCS]; // the controller read by each of the MOD_SRC_CC sources
+    double amp[MOD_MAX_RATE]; // the ramped volume of the control block being rendered
+} ModMatrix;
+
+// instantiate the matrix with no routes
+static inline void mod_init(ModMatrix *m){
+
+    for(int i = 0; i < MOD_MAX_LFOS; i++){
+        m->lfos[i].shape = OSC_SINE;
+        m->lfos[i].rate = 1.0 + i * 2.0;
+        m->lfos[i].retrigger = false;
+    }
+
+    m->routeNum = 0;
+    m->rate = MOD_DEFAULT_RATE;
+
+    for(int i = 0; i < 128; i++)
+        m->cc[i] = 0.0;
+
+    // the mod wheel, breath, foot and expression controllers then the general purpose ones
+    int ccNumbers[MOD_MAX_CCS] = { 1, 2, 4, 11, 16, 17, 18, 19 };
+    for(int i = 0; i < MOD_MAX_CCS; i++)
+        m->ccNumbers[i] = ccNumbers[i];
+}
+
+// sets the amount of the route from a source to a destination, adding it if it doesn't exist and removing it if the amount is 0
+static inline bool mod_route_set(ModMatrix *m, enum MOD_SOURCE source, enum MOD_DEST dest, double amount){
+
+    if(source < 0 || source >= MOD_SOURCES || dest < 0 || dest >= MOD_DESTS)
+        return false;
+
+    for(int i = 0; i < m->routeNum; i++){
+        if(m->routes[i].source == source && m->routes[i].dest == dest){
+            if(amount == 0.0){
+                // keep the routes packed by moving the last one into this space
+                m->routeNum--;
+                m->routes[i] = m->routes[m->routeNum];
+            }
+            else
+                m->routes[i].amount = amount;
+            return true;
+        }
+    }
+
+    if(amount == 0.0)
+        return true;
+    if(m->routeNum >= MOD_MAX_ROUTES)
+        return false;
+
+    m->routes[m->routeNum].source = source;
+    m->routes[m->routeNum].dest = dest;
+    m->routes[m->routeNum].amount = amount;
+    m->routeNum++;
+    return true;
+}
+
+// sets how many samples are in a control block
+static inline void mod_set_rate(ModMatrix *m, unsigned int rate){
+    if(rate < 1)
+        rate = 1;
+    if(rate > MOD_MAX_RATE)
+        rate = MOD_MAX_RATE;
+    m->rate = rate;
+}
+
+// gets the value of an LFO from -1 to 1 for a note at a time
+static inline double mod_lfo(const Lfo *lfo, const Note *n, double time){
+
+    double cycles = lfo->rate * (lfo->retrigger ? time - n->on : time);
+    double x = cycles - floor(cycles); // how far through its cycle the LFO is
+
+    switch(lfo->shape){
+        case OSC_SINE: return sin(OSC_PERIOD * x);
+        case OSC_SQUARE: return (x < 0.5) ? 1.0 : -1.0;
+        // starts at 0 and rises like the sine
+        case OSC_TRIANGLE: return (x < 0.25) ? 4.0 * x : (x < 0.75) ? 2.0 - 4.0 * x : 4.0 * x - 4.0;
+        case OSC_SAW: return 2.0 * x - 1.0;
+        default : return 0.0;
+    }
+}
+
+// gets the value of a source for a note at a time, env is the note's volume at that time out of the peak volume
+static inline double mod_source(const ModMatrix *m, enum MOD_SOURCE source, const Note *n, double time, double env){
+    switch(source){
+        case MOD_SRC_LFO1: case MOD_SRC_LFO2: case MOD_SRC_LFO3: case MOD_SRC_LFO4:
+            return mod_lfo(&m->lfos[source - MOD_SRC_LFO1], n, time);
+        case MOD_SRC_ENVELOPE: return env;
+        case MOD_SRC_VELOCITY: return n->velocity;
+        default : return m->cc[m->ccNumbers[source - MOD_SRC_CC1] & 0x7F];
+    }
+}
+
+// adds up every route into the value of each destination for a note at a time
+static inline void mod_evaluate(const ModMatrix *m, const Note *n, double time, double env, double *dest){
+
+    for(int d = 0; d < MOD_DESTS; d++)
+        dest[d] = 0.0;
+
+    for(int i = 0; i < m->routeNum; i++)
+        dest[m->routes[i].dest] += m->routes[i].amount * mod_source(m, m->routes[i].source, n, time, env);
+}
+
+// starts the ramps of a note from the values of its destinations when it's turned on
+static inline void mod_note_on(const ModMatrix *m, Note *n, double time){
+    mod_evaluate(m, n, time, 0.0, n->modLast);
+}
+
+// checks if a note has to go through the matrix, notes keep going through it until their destinations have ramped back to 0
+static inline bool mod_active(const ModMatrix *m, const Note *n){
+    if(m->routeNum > 0)
+        return true;
+    for(int d = 0; d < MOD_DESTS; d++){
+        if(n->modLast[d] != 0.0)
+            return true;
+    }
+    return false;
+}
+
+// retunes the voices of a note to a pitch offset in semitones and a detune offset in hz
+static inline void mod_tune(Note *n, double pitch, double detuneOffset, unsigned int sampleRate){
+
+    double ratio = pow(2.0, pitch / 12.0);
+    double noteDetune = n->detune + detuneOffset;
+
+    for(int i = 0; i < n->voices; i++){
+        double inc = (n->keyInc + toAng(unison_offset(i, n->voices, noteDetune)) / (double)sampleRate) * ratio;
+        // samples are played back faster or slower by the same amount as the oscillators
+        if(n->zone >= 0 && n->inc[i] != 0.0)
+            n->step[i] *= inc / n->inc[i];
+        n->inc[i] = inc;
+    }
+}
+
+/*
+adds a span of a note to out through the matrix, amp holds the envelope of the span and voices
+is how many unison voices to render, the span is split into control blocks starting at time
+*/
+static inline void mod_render(ModMatrix *m, const SynthParams *p, const Kernels *k, Note *n, double blend, const double *amp, double *out,
+                unsigned int count, double time, double timeStep, int voices, unsigned int sampleRate){
+
+    unsigned int len;
+    for(unsigned int done = 0; done < count; done += len){
+
+        len = (count - done < m->rate) ? count - done : m->rate;
+        double start = time + done * timeStep;
+
+        // find where the destinations are at the end of the block
+        double env = (p->peak > 0.0) ? amp[done + len - 1] / p->peak : 0.0;
+        double next[MOD_DESTS];
+        mod_evaluate(m, n, start + len * timeStep, env, next);
+
+        double mid[MOD_DESTS];
+        for(int d = 0; d < MOD_DESTS; d++)
+            mid[d] = 0.5 * (n->modLast[d] + next[d]);
+
+        // ramp the volume a sample at a time, the note can't be made to go below silent
+        double from = 1.0 + n->modLast[MOD_DEST_AMP];
+        double step = (next[MOD_DEST_AMP] - n->modLast[MOD_DEST_AMP]) / len;
+        for(unsigned int j = 0; j < len; j++){
+            double gain = from + step * (j + 1);
+            m->amp[j] = amp[done + j] * ((gain > 0.0) ? gain : 0.0);
+        }
+
+        mod_tune(n, mid[MOD_DEST_PITCH], mid[MOD_DEST_DETUNE], sampleRate);
+
+        // the depth and blend ramp the same way as the volume, reaching the next values on the last sample
+        double depthFrom = p->modDepth + n->modLast[MOD_DEST_FM_DEPTH];
+        double depthStep = (p->modDepth + next[MOD_DEST_FM_DEPTH] - depthFrom) / len;
+        // the blend is kept within 0 to 1 at both ends, so the ramp between them is too
+        double blendFrom = fmin(fmax(blend + n->modLast[MOD_DEST_BLEND], 0.0), 1.0);
+        double blendStep = (fmin(fmax(blend + next[MOD_DEST_BLEND], 0.0), 1.0) - blendFrom) / len;
+
+        unison(p, k, n, blendFrom + blendStep, blendStep, depthFrom + depthStep, depthStep, m->amp, out + done, len, start, timeStep, voices);
+
+        for(int d = 0; d < MOD_DESTS; d++)
+            n->modLast[d] = next[d];
+    }
+
+    // the note has ramped back out of the matrix, put its voices back to their unmodulated pitch for unison()
+    if(!mod_active(m, n))
+        mod_tune(n, 0.0, 0.0, sampleRate);
+}
+
+#endif //MODMATRIX_H
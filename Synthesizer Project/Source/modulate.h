@@ -1,4 +1,5 @@
 #include "osc.h"
+#include "params.h"
 
 #ifndef MODULATE_H
 #define MODULATE_H
@@ -8,12 +9,11 @@ this header is used to apply a mathmatical algorithm using the oscillator functi
 to achieve frequency modulation
 */
 
-double modDepth; // how much the carrier wave is modulated by the modulation wave
-
-double modulate(double cf, double mf, double depth, double v){
+// cp and mp are the current phases of the carrier and modulating waves, t is the time of the sample
+static inline double modulate(const SynthParams *p, double cp, double mp, double depth, double v, double t){
     
     // returns the result of the FM algorithm as a sample
-    return osc(carrier, (toAng(cf) * globalTime) + depth * (osc(mod, toAng(mf) * globalTime))) * v;
+    return osc(p->carrier, cp + depth * (osc(p->mod, mp, t)), t) * v;
     
 }
 
@@ -1,15 +1,32 @@
 #include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
 
 #ifndef NOTE_H
 #define NOTE_H
 
+#define NOTE_MAX_VOICES 8 // the most unison voices a note can play
+#define NOTE_MOD_DESTS 5 // the destinations of the modulation matrix, see modmatrix.h
+
 // structure which holds all the data needed to abstract a note
 typedef struct Note{
     char id; // the unique identifier of a note
     double f; // the frequency (pitch) of the note
     double on; // the time the note was turned on
     double off; // the time the note was turned off
+    bool released; // if the note has been turned off since it was last turned on, its release starts at off
     bool active; // if the note is still producing sound
+    int voices; // the amount of unison voices the note plays
+    double inc[NOTE_MAX_VOICES]; // the phase increment per sample of each unison voice
+    double phase[NOTE_MAX_VOICES]; // the current phase of each unison voice
+    int zone; // the sample played by the note when the carrier is OSC_SAMPLE, -1 if none
+    double pos[NOTE_MAX_VOICES]; // the playhead of each unison voice within the sample in frames
+    double step[NOTE_MAX_VOICES]; // how many frames each playhead moves per sample
+    _Atomic uint64_t *hint; // where the first playhead is published for the prefetch thread, see sampler.h
+    double velocity; // how hard the note was played from 0 to 1
+    double keyInc; // the phase increment of the key before the voices are detuned
+    double detune; // how far the voices are detuned in hz
+    double modLast[NOTE_MOD_DESTS]; // the value of each modulation destination at the end of the last control block
 } Note;
 
 #endif //NOTE_H
@@ -1,3 +1,4 @@
+#include <stdlib.h>
 #include "note.h"
 
 #ifndef NOTEARRAY_H
@@ -9,63 +10,74 @@ which will be iterated over to generate samples from the notes
 data
 */
 
-Note* notes; // list of notes
-int notesMax; // maximum amount of notes which can be played at once
-int notesCurrent; // the current amount of notes in the array
+// structure which holds a list of notes
+typedef struct NoteList{
+    Note* notes; // list of notes
+    int max; // maximum amount of notes which can be played at once
+    int current; // the current amount of notes in the array
+} NoteList;
 
 // instantiate the note list
-void notes_init(int max){
+static inline void notes_init(NoteList *l, int max){
     
     // set the max and current
-    notesMax = max;
-    notesCurrent = 0;
+    l->max = max;
+    l->current = 0;
     
     // allocate memory based on the max size of the list
-    notes = malloc(notesMax * sizeof(Note));
+    l->notes = malloc(l->max * sizeof(Note));
     
     // generate a blank note and fill the list with it to ensure there are no NULL spaces
     Note blankNote;
     blankNote.id = -1;
     blankNote.f = 0;
     
-    for(int i = 0; i < notesMax; i++){
-        notes[i] = blankNote; 
+    for(int i = 0; i < l->max; i++){
+        l->notes[i] = blankNote; 
     }
 }
 
+// frees the memory held by the note list
+static inline void notes_free(NoteList *l){
+    free(l->notes);
+    l->notes = NULL;
+    l->max = 0;
+    l->current = 0;
+}
+
 // this function is used for adding a note to the note array
-void note_add(Note n){
+static inline void note_add(NoteList *l, Note n){
     
     // if the array is not full
-    if(notesCurrent < notesMax - 1){
-        notes[notesCurrent] = n; // add the note
-        notesCurrent++; // increment current notes int
+    if(l->current < l->max - 1){
+        l->notes[l->current] = n; // add the note
+        l->current++; // increment current notes int
     }
 }
 
 // this function is used for removing a note from the list
-void note_remove(Note n){
+static inline void note_remove(NoteList *l, Note n){
     // iterate through every note in the list to find the one to be removed
-    for(int i = 0; i < notesCurrent; i++){
+    for(int i = 0; i < l->current; i++){
         // once the note is found
-        if(notes[i].id == n.id){
+        if(l->notes[i].id == n.id){
             // iterate over every note ahead of this note and decrement its position by one
-            for(int j = i; j < notesCurrent; j++){
-                notes[j] = notes[j + 1];
+            for(int j = i; j < l->current; j++){
+                l->notes[j] = l->notes[j + 1];
             }
-            notesCurrent--; // decrement the current amount of notes
+            l->current--; // decrement the current amount of notes
             return;
         }
     }
 }
 
 // this function returns a pointer to a note from it's id
-Note* note_get(char id){
+static inline Note* note_get(NoteList *l, char id){
     // iterate over each note
-    for(int i = 0; i < notesCurrent; i++){
+    for(int i = 0; i < l->current; i++){
         // if the ID and the note ID match
-        if(notes[i].id == id){
-            return &notes[i]; // return the note pointer
+        if(l->notes[i].id == id){
+            return &l->notes[i]; // return the note pointer
         }
     }
     
@@ -1,6 +1,10 @@
+#include <math.h>
+#include <stdlib.h>
+
 #ifndef OSC_H
 #define OSC_H
 #define PI 3.1415
+#define OSC_PERIOD 6.283185307179586 // the true period of sin(), phases wrap at this rather than 2 * PI
 
 // enum describes the type of oscillator
 enum OSC_TYPE{
@@ -8,31 +12,26 @@ enum OSC_TYPE{
     OSC_SQUARE,
     OSC_TRIANGLE,
     OSC_SAW,
-    OSC_NOISE
+    OSC_NOISE,
+    OSC_SAMPLE // plays the multisample loaded by sampler.h, only used as a carrier
 };
 
-/*
- In Frequency Modulation a modulating/information wave is used to modulate the frequency of a carrier wave
-which drastically changes how the wave sounds by making it more complex
-*/
-enum OSC_TYPE carrier; // the type of the carrier wave
-enum OSC_TYPE mod; // the type of the modulating wave
-
 // gets the angular velocity from the frequency
-double toAng(double f){
+static inline double toAng(double f){
     return f * 2.0 * PI;
 }
 
 /* 
 this function applies other functions to a frequency to convert it into a wave
 the type of wave generated by the function depends on the oscillator type required
+t is the time of the sample, which the square wave is gathered from
 */
-double osc(enum OSC_TYPE oscT, double f){
+static inline double osc(enum OSC_TYPE oscT, double f, double t){
     switch(oscT){
         // Sine wave
         case OSC_SINE: return sin(f);
         // Square wave 
-        case OSC_SQUARE: return (sin(f) * globalTime > 1) ? 1 : -1; // binary value gathered from sin wave
+        case OSC_SQUARE: return (sin(f) * t > 1) ? 1 : -1; // binary value gathered from sin wave
         // Triangle wave
         case OSC_TRIANGLE: return asin(sin(f)); // arcsin of a sin wave
         // Generate white noise from pseudo-random input
@@ -0,0 +1,31 @@
+#include "osc.h"
+
+#ifndef PARAMS_H
+#define PARAMS_H
+
+/*
+this header holds the sound parameters of a synth, every instance of the engine has its own
+copy which is only changed on the audio thread by parameter events
+*/
+
+typedef struct SynthParams{
+    /*
+ In Frequency Modulation a modulating/information wave is used to modulate the frequency of a carrier wave
+which drastically changes how the wave sounds by making it more complex
+*/
+    enum OSC_TYPE carrier; // the type of the carrier wave
+    enum OSC_TYPE mod; // the type of the modulating wave
+    double modDepth; // how much the carrier wave is modulated by the modulation wave
+
+    double detune; // Controls the amount each voice is detuned by
+    int unisonVoices; // the amount of unison voices each new note is given
+
+    // the ADSR envelope, see envelope.h
+    double attackTime;
+    double decayTime;
+    double sustainAmp;
+    double releaseTime;
+    double peak;
+} SynthParams;
+
+#endif //PARAMS_H
@@ -0,0 +1,483 @@
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <pthread.h>
+#include "note.h"
+#include "tuning.h"
+#include "global.h"
+
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+/*
+this header plays multisampled WAV files as the OSC_SAMPLE oscillator
+each sample (called a zone) covers a range of keys and is pitch shifted from its root key
+to the frequency of the note, using the same tuning table as every other oscillator
+
+the files are memory mapped rather than loaded so libraries larger than the memory of the
+machine can be played, only a small window at the start of each sample is kept resident,
+the rest is paged in from disk by a prefetch thread which reads ahead of every playhead
+before the audio thread reaches it
+
+zones are listed in a text file, one per line: path rootKey lowKey highKey
+lines starting with # are comments
+
+the zones are loaded once for the whole program and only read afterwards, so every instance
+of the synth plays from the same mapped files, each synth publishes its own playheads in a
+SamplerHints which it registers with the prefetch thread
+*/
+
+#define SAMPLER_MAX_ZONES 256
+#define SAMPLER_PRELOAD (64 * 1024) // the bytes at the start of each sample kept resident
+#define SAMPLER_PREFETCH (256 * 1024) // how many bytes ahead of each playhead are paged in
+#define SAMPLER_PAGE 4096 // the stride used to touch pages
+#define SAMPLER_PREFETCH_MS 5 // how often the prefetch thread looks at the playheads
+#define SAMPLER_MAX_SYNTHS 64 // how many synths the prefetch thread reads ahead for
+
+// the sample formats that can be played
+enum SAMPLE_FORMAT{
+    SAMPLE_PCM16,
+    SAMPLE_PCM24,
+    SAMPLE_FLOAT32
+};
+
+// structure which holds a single memory mapped sample
+typedef struct SampleZone{
+    const unsigned char *map; // the start of the mapped file
+    size_t mapSize; // the size of the mapped file
+    const unsigned char *data; // the first frame of audio within the file
+    long frames; // the amount of frames in the sample
+    int channels;
+    int frameSize; // the size of a frame in bytes
+    enum SAMPLE_FORMAT format;
+    unsigned int rate; // the sample rate the file was recorded at
+    int root; // the key the sample plays at its recorded pitch
+    int low; // the lowest key the sample is played for
+    int high; // the highest key the sample is played for
+} SampleZone;
+
+SYNTH_GLOBAL SampleZone zones[SAMPLER_MAX_ZONES];
+SYNTH_GLOBAL int zoneNum;
+
+/*
+the playhead of each sounding key of a synth for the prefetch thread, written by the thread rendering it
+the zone + 1 is held in the low 16 bits and the frame in the rest, 0 means nothing is playing
+*/
+typedef struct SamplerHints{
+    _Atomic uint64_t key[TUNING_KEYS];
+} SamplerHints;
+
+SYNTH_GLOBAL SamplerHints *samplerHintSets[SAMPLER_MAX_SYNTHS]; // the hints of every registered synth
+SYNTH_GLOBAL int samplerHintSetNum;
+// held while the list is changed or read
+#ifdef SYNTH_IMPLEMENTATION
+pthread_mutex_t samplerHintLock = PTHREAD_MUTEX_INITIALIZER;
+#else
+extern pthread_mutex_t samplerHintLock;
+#endif
+SYNTH_GLOBAL _Atomic bool samplerRunning;
+SYNTH_GLOBAL pthread_t samplerThread;
+
+// reads little endian values from a wav file
+static inline uint32_t sampler_u32(const unsigned char *p){
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint16_t sampler_u16(const unsigned char *p){
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+// maps a whole file into memory, returns NULL on failure
+static inline const unsigned char* sampler_map(const char *path, size_t *size){
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if(file == INVALID_HANDLE_VALUE)
+        return NULL;
+
+    LARGE_INTEGER fileSize;
+    GetFileSizeEx(file, &fileSize);
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file); // the mapping keeps the file open
+    if(mapping == NULL)
+        return NULL;
+
+    const unsigned char *map = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping); // the view keeps the mapping open
+    *size = (size_t)fileSize.QuadPart;
+    return map;
+#else
+    int file = open(path, O_RDONLY);
+    if(file < 0)
+        return NULL;
+
+    struct stat st;
+    if(fstat(file, &st) != 0 || st.st_size == 0){
+        close(file);
+        return NULL;
+    }
+
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, file, 0);
+    close(file); // the mapping keeps the file open
+    if(map == MAP_FAILED)
+        return NULL;
+
+    *size = st.st_size;
+    return map;
+#endif
+}
+
+static inline void sampler_unmap(const unsigned char *map, size_t size){
+#ifdef _WIN32
+    UnmapViewOfFile(map);
+#else
+    munmap((void*)map, size);
+#endif
+}
+
+// keeps the start of a sample in memory so notes can start without waiting for the disk
+static inline void sampler_preload(SampleZone *z){
+
+    size_t size = z->frames * z->frameSize;
+    if(size > SAMPLER_PRELOAD)
+        size = SAMPLER_PRELOAD;
+
+    // locking can fail without permission, touching the pages still loads them
+#ifdef _WIN32
+    VirtualLock((void*)z->data, size);
+#else
+    mlock(z->data, size);
+#endif
+    volatile unsigned char sum = 0;
+    for(size_t i = 0; i < size; i += SAMPLER_PAGE)
+        sum += z->data[i];
+}
+
+// finds the format and audio data of a mapped wav file
+static inline bool sampler_parse_wav(SampleZone *z){
+
+    const unsigned char *p = z->map;
+    size_t size = z->mapSize;
+
+    if(size < 12 || memcmp(p, "RIFF", 4) != 0 || memcmp(p + 8, "WAVE", 4) != 0)
+        return false;
+
+    int tag = 0;
+    int bits = 0;
+    bool foundFmt = false;
+
+    // walk through every chunk of the file
+    size_t pos = 12;
+    while(pos + 8 <= size){
+        const unsigned char *chunk = p + pos;
+        size_t chunkSize = sampler_u32(chunk + 4);
+
+        if(memcmp(chunk, "fmt ", 4) == 0 && chunkSize >= 16 && pos + 8 + chunkSize <= size){
+            tag = sampler_u16(chunk + 8);
+            z->channels = sampler_u16(chunk + 10);
+            z->rate = sampler_u32(chunk + 12);
+            bits = sampler_u16(chunk + 22);
+            // extensible files keep the real format tag in the sub format
+            if(tag == 0xFFFE && chunkSize >= 26)
+                tag = sampler_u16(chunk + 32);
+            foundFmt = true;
+        }
+        else if(memcmp(chunk, "data", 4) == 0 && foundFmt){
+            // trust the file size over a damaged data size
+            if(pos + 8 + chunkSize > size)
+                chunkSize = size - pos - 8;
+
+            if(tag == 1 && bits == 16)
+                z->format = SAMPLE_PCM16;
+            else if(tag == 1 && bits == 24)
+                z->format = SAMPLE_PCM24;
+            else if(tag == 3 && bits == 32)
+                z->format = SAMPLE_FLOAT32;
+            else
+                return false;
+
+            if(z->channels < 1 || z->rate == 0)
+                return false;
+
+            z->frameSize = z->channels * bits / 8;
+            z->data = chunk + 8;
+            z->frames = chunkSize / z->frameSize;
+            return z->frames > 1;
+        }
+
+        // chunks are padded to an even size
+        pos += 8 + chunkSize + (chunkSize & 1);
+    }
+    return false;
+}
+
+// maps a wav file into a new zone
+static inline bool sampler_add_zone(const char *path, int root, int low, int high){
+
+    if(zoneNum >= SAMPLER_MAX_ZONES){
+        printf("Sampler Error: Too many samples, %s was not loaded\n", path);
+        return false;
+    }
+
+    SampleZone *z = &zones[zoneNum];
+    memset(z, 0, sizeof(SampleZone));
+    z->root = root;
+    z->low = low;
+    z->high = high;
+
+    z->map = sampler_map(path, &z->mapSize);
+    if(z->map == NULL){
+        printf("Sampler Error: Unable to map %s\n", path);
+        return false;
+    }
+
+    if(!sampler_parse_wav(z)){
+        printf("Sampler Error: %s is not a 16 bit, 24 bit or float wav file\n", path);
+        sampler_unmap(z->map, z->mapSize);
+        return false;
+    }
+
+    sampler_preload(z);
+    zoneNum++;
+    return true;
+}
+
+// loads every zone listed in a text file, returns the amount of zones loaded
+static inline int sampler_load(const char *listPath){
+
+    FILE *file = fopen(listPath, "r");
+    if(file == NULL){
+        printf("Sampler Error: Unable to open %s\n", listPath);
+        return 0;
+    }
+
+    char line[1024];
+    char path[1024];
+    int loaded = 0;
+
+    while(fgets(line, sizeof(line), file) != NULL){
+        int root, low, high;
+        // skip comments and lines which don't describe a zone
+        if(line[0] == '#' || sscanf(line, "%1023s %d %d %d", path, &root, &low, &high) != 4)
+            continue;
+        if(sampler_add_zone(path, root, low, high))
+            loaded++;
+    }
+
+    fclose(file);
+    printf("Sampler Loaded %d Samples\n", loaded);
+    return loaded;
+}
+
+// finds the zone played by a key, the zone with the closest root is used when ranges overlap
+static inline int sampler_find_zone(char key){
+    int found = -1;
+    for(int i = 0; i < zoneNum; i++){
+        if(key < zones[i].low || key > zones[i].high)
+            continue;
+        if(found < 0 || abs(zones[i].root - key) < abs(zones[found].root - key))
+            found = i;
+    }
+    return found;
+}
+
+// sets up the playheads of a note, the unison voices must already have been prepared, hints are those of the note's synth
+static inline void sampler_prepare(Note *n, const Tuning *t, unsigned int sampleRate, SamplerHints *hints){
+
+    n->hint = &hints->key[n->id & 0x7F];
+    n->zone = sampler_find_zone(n->id);
+    if(n->zone < 0)
+        return;
+
+    SampleZone *z = &zones[n->zone];
+
+    // the root frequency comes from the same table as the note's so they're tuned the same way
+    double rootF, rootInc;
+    tuning_key(t, z->root, &rootF, &rootInc);
+
+    for(int i = 0; i < n->voices; i++){
+        n->pos[i] = 0.0;
+        // the ratio of the voice to the root, converted from the recorded rate to the output rate
+        n->step[i] = (rootInc > 0.0) ? (n->inc[i] / rootInc) * z->rate / (double)sampleRate : 0.0;
+    }
+}
+
+// gets a single frame of a zone as a mono sample, frames outside the sample are silent
+static inline double sampler_frame(const SampleZone *z, long frame){
+
+    if(frame < 0 || frame >= z->frames)
+        return 0.0;
+
+    const unsigned char *p = z->data + frame * z->frameSize;
+    double sum = 0.0;
+
+    // mix all channels down to mono
+    for(int c = 0; c < z->channels; c++){
+        switch(z->format){
+            case SAMPLE_PCM16: sum += (int16_t)sampler_u16(p) / 32768.0; p += 2; break;
+            case SAMPLE_PCM24: {
+                // move the 3 bytes to the top of an int so the sign is kept
+                int32_t v = (int32_t)(((uint32_t)p[0] << 8) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 24));
+                sum += v / 2147483648.0;
+                p += 3;
+            }; break;
+            case SAMPLE_FLOAT32: {
+                float f;
+                memcpy(&f, p, sizeof(float));
+                sum += f;
+                p += 4;
+            }; break;
+        }
+    }
+    return sum / z->channels;
+}
+
+// reads one voice of a note at its playhead with 4 point hermite interpolation and steps it forward
+static inline double sampler_read(Note *n, int voice){
+
+    if(n->zone < 0)
+        return 0.0;
+
+    const SampleZone *z = &zones[n->zone];
+    double pos = n->pos[voice];
+    long i = (long)pos;
+
+    // the sample has finished, there's nothing left to prefetch
+    if(i >= z->frames){
+        if(voice == 0)
+            atomic_store_explicit(n->hint, 0, memory_order_relaxed);
+        return 0.0;
+    }
+
+    double t = pos - i;
+    double y0 = sampler_frame(z, i - 1);
+    double y1 = sampler_frame(z, i);
+    double y2 = sampler_frame(z, i + 1);
+    double y3 = sampler_frame(z, i + 2);
+
+    double c1 = 0.5 * (y2 - y0);
+    double c2 = y0 - 2.5 * y1 + 2.0 * y2 - 0.5 * y3;
+    double c3 = 0.5 * (y3 - y0) + 1.5 * (y1 - y2);
+
+    n->pos[voice] = pos + n->step[voice];
+
+    // tell the prefetch thread where the first voice is
+    if(voice == 0)
+        atomic_store_explicit(n->hint, ((uint64_t)i << 16) | (n->zone + 1), memory_order_relaxed);
+
+    return ((c3 * t + c2) * t + c1) * t + y1;
+}
+
+// stops prefetching for a note which is being removed
+static inline void sampler_release(const Note *n){
+    if(n->zone >= 0)
+        atomic_store_explicit(n->hint, 0, memory_order_relaxed);
+}
+
+// adds the hints of a synth to the ones the prefetch thread reads, returns false if there are too many synths
+static inline bool sampler_register(SamplerHints *hints){
+
+    for(int key = 0; key < TUNING_KEYS; key++)
+        hints->key[key] = 0;
+
+    pthread_mutex_lock(&samplerHintLock);
+    bool added = samplerHintSetNum < SAMPLER_MAX_SYNTHS;
+    if(added){
+        samplerHintSets[samplerHintSetNum] = hints;
+        samplerHintSetNum++;
+    }
+    pthread_mutex_unlock(&samplerHintLock);
+    return added;
+}
+
+// removes the hints of a synth, once this returns the prefetch thread won't read them again
+static inline void sampler_unregister(SamplerHints *hints){
+
+    pthread_mutex_lock(&samplerHintLock);
+    for(int i = 0; i < samplerHintSetNum; i++){
+        if(samplerHintSets[i] == hints){
+            samplerHintSetNum--;
+            samplerHintSets[i] = samplerHintSets[samplerHintSetNum];
+            break;
+        }
+    }
+    pthread_mutex_unlock(&samplerHintLock);
+}
+
+static inline void sampler_sleep(int ms){
+#ifdef _WIN32
+    Sleep(ms);
+#else
+    struct timespec ts = { 0, ms * 1000000L };
+    nanosleep(&ts, NULL);
+#endif
+}
+
+// a seperate thread which pages in the part of each sample just ahead of its playhead
+static inline void *sampler_prefetch_thread(void *args){
+
+    volatile unsigned char sum = 0;
+
+    while(samplerRunning){
+        // the lock keeps synths from being destroyed while their hints are read, it's never taken by the audio thread
+        pthread_mutex_lock(&samplerHintLock);
+        for(int s = 0; s < samplerHintSetNum; s++){
+            for(int key = 0; key < TUNING_KEYS; key++){
+                uint64_t hint = atomic_load_explicit(&samplerHintSets[s]->key[key], memory_order_relaxed);
+                if(hint == 0)
+                    continue;
+
+                const SampleZone *z = &zones[(hint & 0xFFFF) - 1];
+                size_t start = (size_t)(hint >> 16) * z->frameSize;
+                size_t end = start + SAMPLER_PREFETCH;
+                size_t size = (size_t)z->frames * z->frameSize;
+                if(end > size)
+                    end = size;
+
+                // reading a byte from each page makes the os load it from disk if it isn't in memory
+                for(size_t i = start; i < end; i += SAMPLER_PAGE)
+                    sum += z->data[i];
+            }
+        }
+        pthread_mutex_unlock(&samplerHintLock);
+        sampler_sleep(SAMPLER_PREFETCH_MS);
+    }
+    return NULL;
+}
+
+// starts the prefetch thread once the zones have been loaded, returns false if it couldn't be started
+static inline bool sampler_init(){
+    samplerRunning = true;
+    if(pthread_create(&samplerThread, NULL, &sampler_prefetch_thread, NULL) != 0){
+        samplerRunning = false;
+        printf("Sampler Error: Unable to start the prefetch thread\n");
+        return false;
+    }
+    return true;
+}
+
+// stops the prefetch thread and unmaps every zone, no synth may be playing samples
+static inline void sampler_shutdown(){
+
+    if(samplerRunning){
+        samplerRunning = false;
+        pthread_join(samplerThread, NULL);
+    }
+
+    for(int i = 0; i < zoneNum; i++)
+        sampler_unmap(zones[i].map, zones[i].mapSize);
+    zoneNum = 0;
+}
+
+#endif //SAMPLER_H
@@ -0,0 +1,160 @@
+#ifdef _WIN32
+#include <winsock2.h>
+#else
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "synth.h"
+
+#ifndef SERVER_H
+#define SERVER_H
+
+/*
+this header runs the synth headless as a server which is controlled over a local UDP socket
+instead of the keyboard, any number of programs on the same machine can send to the server
+and every packet they send is pushed onto the event queue of the synth being played as one batch
+
+packets are a 4 byte header followed by any number of 12 byte messages, all values are little endian
+
+header:  'S' 'Y' 'N' version(1)
+message: type(1) id(1) reserved(2) offset(4) value(4)
+* type is a SYNTH_EVENT, or SERVER_QUIT to stop the server
+* id is the key of a note, the SYNTH_PARAM of a parameter change, the controller number of a cc
+  or the route of a modulation route, (source << 3) | destination
+* offset is how many microseconds after the packet arrives the event is played,
+  so a batch of events keeps its timing, events are played in time order whichever
+  packet or input they came from, events due at the same time in the order they are sent
+* value is the new value of a parameter, controller or route amount, or the velocity of a note on,
+  as a 32 bit float
+*/
+
+#define SERVER_PORT 9000 // the default port the server listens on
+#define SERVER_VERSION 1
+#define SERVER_HEADER 4 // the size of a packet header in bytes
+#define SERVER_MESSAGE 12 // the size of a message in bytes
+#define SERVER_MAX_PACKET (SERVER_HEADER + SERVER_MESSAGE * 128)
+#define SERVER_QUIT 0xFF // message type which stops the server
+
+#ifdef _WIN32
+typedef SOCKET server_socket;
+#else
+typedef int server_socket;
+#define INVALID_SOCKET -1
+#define closesocket close
+#endif
+
+// called when the server can't be started
+static inline void server_error(const char *msg){
+#ifdef _WIN32
+    printf("Server Error: %s (%d)\n", msg, WSAGetLastError());
+#else
+    printf("Server Error: %s (%s)\n", msg, strerror(errno));
+#endif
+    exit(1);
+}
+
+// reads little endian values from a packet
+static inline uint32_t server_read_u32(const unsigned char *p){
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline float server_read_f32(const unsigned char *p){
+    uint32_t bits = server_read_u32(p);
+    float f;
+    memcpy(&f, &bits, sizeof(float));
+    return f;
+}
+
+/*
+converts a packet into events timestamped from the time it arrived, returns the amount of events
+quit is set if the packet asks the server to stop
+*/
+static inline int server_parse(const unsigned char *packet, int size, double arrival, SynthEvent *events, bool *quit){
+
+    // ignore anything which isn't a packet for this server
+    if(size < SERVER_HEADER || packet[0] != 'S' || packet[1] != 'Y' || packet[2] != 'N' || packet[3] != SERVER_VERSION)
+        return 0;
+
+    int count = 0;
+    for(int i = SERVER_HEADER; i + SERVER_MESSAGE <= size; i += SERVER_MESSAGE){
+        const unsigned char *msg = packet + i;
+
+        if(msg[0] == SERVER_QUIT){
+            *quit = true;
+            continue;
+        }
+        // skip message types this version doesn't know
+        if(msg[0] < EVENT_NOTE_ON || msg[0] > EVENT_MOD_ROUTE)
+            continue;
+
+        events[count].type = msg[0];
+        events[count].id = msg[1] & 0x7F;
+        events[count].time = arrival + server_read_u32(msg + 4) / 1000000.0;
+        events[count].value = server_read_f32(msg + 8);
+        count++;
+    }
+    return count;
+}
+
+// runs the server for a synth on this thread until a quit message is received, blocks while waiting so no cpu is used
+static inline void server_run(Synth *synth, unsigned short port){
+
+#ifdef _WIN32
+    WSADATA wsa;
+    if(WSAStartup(MAKEWORD(2, 2), &wsa) != 0)
+        server_error("Unable to start winsock");
+#endif
+
+    server_socket s = socket(AF_INET, SOCK_DGRAM, 0);
+    if(s == INVALID_SOCKET)
+        server_error("Unable to create socket");
+
+    // only listen to programs on this machine
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if(bind(s, (struct sockaddr*)&addr, sizeof(addr)) != 0)
+        server_error("Unable to bind socket");
+
+    printf("Server Listening on 127.0.0.1:%d\n", port);
+
+    unsigned char packet[SERVER_MAX_PACKET];
+    SynthEvent events[SERVER_MAX_PACKET / SERVER_MESSAGE];
+    bool quit = false;
+
+    while(!quit){
+        // wait for the next packet from any client
+        int size = recvfrom(s, (char*)packet, SERVER_MAX_PACKET, 0, NULL, NULL);
+        if(size <= 0)
+            continue;
+
+        // stamp the packet as soon as it arrives, in the synth's time so it keeps its place within a block
+        double arrival = synth_now(synth);
+
+        int count = server_parse(packet, size, arrival, events, &quit);
+        if(count > 0 && !synth_send(synth, events, count))
+            printf("Server: Event queue full, dropped %d events\n", count);
+
+        // the audio thread can't print, so changes to the level of detail are reported here
+        lod_report(&synth->lod);
+    }
+
+    closesocket(s);
+#ifdef _WIN32
+    WSACleanup();
+#endif
+    printf("Server Closed\n");
+}
+
+#endif //SERVER_H
@@ -0,0 +1,365 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include "params.h"
+#include "kernels.h"
+#include "notearray.h"
+#include "tuning.h"
+#include "sampler.h"
+#include "unison.h"
+#include "envelope.h"
+#include "events.h"
+#include "lod.h"
+#include "modmatrix.h"
+
+#ifndef SYNTH_H
+#define SYNTH_H
+
+/*
+this header ties the note list, tuning, unison and envelope together into the engine
+every synth is a seperate instance with its own time, parameters, notes, event queue,
+modulation and level of detail, so several can be rendered at once on different threads
+(offline renders, a plugin host running more than one copy, or tests running in parallel)
+
+notes are turned on and off by id from whichever input is driving the synth, and the
+audio thread pulls blocks of samples from synth_render, inputs on other threads send their
+notes and parameter changes through the synth's event queue and synth_render plays them on
+the sample they are due
+
+only one thread may render a synth at a time, any thread can send it events
+
+the headers can be included from any number of source files, exactly one of them has to define
+SYNTH_IMPLEMENTATION first so the shared state is defined there, see global.h
+*/
+
+#define SYNTH_SPAN 256 // the most samples rendered at once, this keeps the buffers small enough to stay in the cache
+#define SYNTH_BLEND 0.4 // the volume of the blended unison voices
+
+// structure which holds a single instance of the engine
+typedef struct Synth{
+    unsigned int sampleRate;
+    _Atomic double time; // the time of the synth in seconds, moved forward by every rendered span
+    SynthParams params; // only changed on the rendering thread, by parameter events
+    Kernels kernels; // the kernel set this synth renders with
+    _Atomic(Tuning*) tuning; // the tuning table new notes should use
+    _Atomic(Tuning*) tuningInUse; // the table the rendering thread is reading, published at the start of every block
+    Tuning* tuningRetired; // a swapped out table which was still in use, freed on a later swap
+    NoteList notes;
+    EventQueue events;
+    ModMatrix mod;
+    Lod lod;
+    SamplerHints samplerHints; // where the notes' playheads are published for the sampler's prefetch thread
+    double amp[SYNTH_SPAN]; // the envelope of the note being rendered
+} Synth;
+
+/*
+creates a synth which renders at a sample rate with up to maxNotes notes at once, it starts
+with the default patch in 12-TET at A440 and the fastest kernels the cpu can run,
+returns NULL if it couldn't be created
+*/
+static inline Synth* synth_create(unsigned int sampleRate, int maxNotes){
+
+    // the kernels are found by whichever synth is created first
+    kernels_init();
+
+    Synth *s = malloc(sizeof(Synth));
+    if(s == NULL)
+        return NULL;
+
+    Tuning *t = tuning_create_tet(440.0, sampleRate);
+    if(t == NULL){
+        free(s);
+        return NULL;
+    }
+
+    s->sampleRate = sampleRate;
+    s->time = 0.0;
+
+    s->params.carrier = OSC_SINE;
+    s->params.mod = OSC_SINE;
+    s->params.modDepth = 0.0;
+    s->params.detune = 0.0;
+    s->params.unisonVoices = 5;
+    s->params.attackTime = 2.0;
+    s->params.decayTime = 2.0;
+    s->params.sustainAmp = 0.3;
+    s->params.releaseTime = 2.0;
+    s->params.peak = 0.3;
+
+    s->kernels = kernels;
+    s->tuning = t;
+    s->tuningInUse = t;
+    s->tuningRetired = NULL;
+
+    notes_init(&s->notes, maxNotes);
+    events_init(&s->events);
+    mod_init(&s->mod);
+    lod_init(&s->lod);
+    // a synth which doesn't fit is still played, its samples just aren't read ahead
+    sampler_register(&s->samplerHints);
+
+    return s;
+}
+
+// frees a synth, it must not be being rendered or sent events
+static inline void synth_destroy(Synth *s){
+    if(s == NULL)
+        return;
+    sampler_unregister(&s->samplerHints);
+    notes_free(&s->notes);
+    events_free(&s->events);
+    free(atomic_load(&s->tuning));
+    // the table in use is either the current one or the retired one
+    free(s->tuningRetired);
+    free(s);
+}
+
+/*
+swaps the tuning table of a synth, this is only called from the control thread
+the rendering thread publishes the table it is reading in tuningInUse, a table is only freed once
+it isn't in use, otherwise it's retired and freed on a later swap once the rendering thread has moved on
+*/
+static inline void synth_set_tuning(Synth *s, Tuning *t){
+
+    if(t == NULL)
+        return;
+
+    Tuning *old = atomic_exchange(&s->tuning, t);
+    Tuning *inUse = atomic_load(&s->tuningInUse);
+
+    // only one table can be in use, so at most one is left retired
+    if(s->tuningRetired != NULL && s->tuningRetired != inUse){
+        free(s->tuningRetired);
+        s->tuningRetired = NULL;
+    }
+    if(old != inUse)
+        free(old);
+    else
+        s->tuningRetired = old;
+}
+
+/*
+called by the rendering thread before a block, publishes the table it will read for the block
+the table is checked again after it's published, if it was swapped in between the control thread
+might not have seen it in use so it's loaded again
+*/
+static inline void synth_acquire_tuning(Synth *s){
+    Tuning *t;
+    do{
+        t = atomic_load(&s->tuning);
+        atomic_store(&s->tuningInUse, t);
+    } while(t != atomic_load(&s->tuning));
+}
+
+// loads a scala tuning and swaps it into a synth, the current tuning is kept if the files are invalid
+static inline bool synth_load_scala(Synth *s, const char *sclPath, const char *kbmPath){
+
+    Tuning *t = tuning_create_scala(sclPath, kbmPath, s->sampleRate);
+    if(t == NULL)
+        return false;
+
+    synth_set_tuning(s, t);
+    printf("Tuning Loaded: %s\n", sclPath);
+    return true;
+}
+
+// sends a batch of events to a synth from any thread, returns false if its queue is full
+static inline bool synth_send(Synth *s, const SynthEvent *events, int count){
+    return events_push(&s->events, events, count);
+}
+
+// sends a parameter change to a synth which is played as soon as possible
+static inline bool synth_send_param(Synth *s, enum SYNTH_PARAM param, float value){
+    SynthEvent e;
+    e.time = s->time;
+    e.type = EVENT_PARAM;
+    e.id = param;
+    e.value = value;
+    return synth_send(s, &e, 1);
+}
+
+// gets the time of a synth an event arriving now should be played at, see events_sync_clock
+static inline double synth_now(Synth *s){
+    return events_clock_to_time(&s->events, events_now());
+}
+
+// turns on the note with the given id and velocity (0 to 1), or restarts its envelope if it's still sounding
+static inline void synth_note_on(Synth *s, char id, double velocity){
+
+    double time = s->time;
+    // the table published for this block, see synth_acquire_tuning
+    Tuning *t = atomic_load_explicit(&s->tuningInUse, memory_order_relaxed);
+
+    // create a new note from the id
+    Note n;
+    n.id = id;
+    n.velocity = velocity;
+    double keyInc;
+    tuning_key(t, n.id, &n.f, &keyInc); // get the frequency and phase increment of the id from the tuning table
+    n.active = true; // bool ensures the note won't be removed and will use Envelope system
+    n.on = time; // get the time the note was turned on at
+    n.off = 0.0; // the time the note was turned off at (hasn't been turned off)
+    n.released = false;
+
+    // keys which aren't mapped by the tuning are silent
+    if(n.f <= 0.0)
+        return;
+
+    // check if the note already exists within the note list
+    Note* found = note_get(&s->notes, n.id);
+
+    // if the note is not yet in the note list
+    if(found == NULL){
+        unison_prepare(&n, keyInc, s->params.detune, s->params.unisonVoices, time, s->sampleRate); // detune each voice
+        sampler_prepare(&n, t, s->sampleRate, &s->samplerHints); // find the sample played by the note
+        mod_note_on(&s->mod, &n, time); // start the modulation from where it is now
+        note_add(&s->notes, n); // add it to the list
+    }
+    // if the note is already in the note list but not finished making noise
+    else{
+        found->f = n.f; // pick up any change in tuning
+        found->velocity = velocity;
+        unison_prepare(found, keyInc, s->params.detune, s->params.unisonVoices, time, s->sampleRate);
+        sampler_prepare(found, t, s->sampleRate, &s->samplerHints);
+        found->on = time; // reset the envelope
+        found->released = false; // an off at the same time as this on was played first, so the note is held again
+        found->active = true; // ensure it isn't removed from the notelist
+    }
+}
+
+// releases the note with the given id, a note which is already released carries on with its release
+static inline void synth_note_off(Synth *s, char id){
+    Note* found = note_get(&s->notes, id);
+    if(found != NULL && !found->released){
+        found->off = s->time; // set the note off time for the Envelope release phase
+        found->released = true;
+    }
+}
+
+// plays an event from the event queue on the audio thread
+static inline void synth_apply_event(Synth *s, const SynthEvent *e){
+    SynthParams *p = &s->params;
+    Lfo *lfos = s->mod.lfos;
+    switch(e->type){
+        // senders which don't give a velocity leave it at 0, which plays the note at full velocity
+        case EVENT_NOTE_ON: synth_note_on(s, e->id, (e->value > 0.0f) ? e->value : 1.0); break;
+        case EVENT_NOTE_OFF: synth_note_off(s, e->id); break;
+        case EVENT_PARAM: {
+            switch(e->id){
+                case PARAM_DETUNE: p->detune = e->value; break;
+                case PARAM_MOD_DEPTH: p->modDepth = e->value; break;
+                case PARAM_CARRIER: p->carrier = (enum OSC_TYPE)e->value; break;
+                case PARAM_MOD: p->mod = (enum OSC_TYPE)e->value; break;
+                case PARAM_ATTACK: p->attackTime = e->value; break;
+                case PARAM_DECAY: p->decayTime = e->value; break;
+                case PARAM_SUSTAIN: p->sustainAmp = e->value; break;
+                case PARAM_RELEASE: p->releaseTime = e->value; break;
+                case PARAM_PEAK: p->peak = e->value; break;
+                case PARAM_VOICES: p->unisonVoices = (int)e->value; break;
+                case PARAM_MOD_RATE: mod_set_rate(&s->mod, (unsigned int)e->value); break;
+                case PARAM_LFO1_RATE: case PARAM_LFO2_RATE: case PARAM_LFO3_RATE: case PARAM_LFO4_RATE:
+                    lfos[e->id - PARAM_LFO1_RATE].rate = e->value; break;
+                case PARAM_LFO1_SHAPE: case PARAM_LFO2_SHAPE: case PARAM_LFO3_SHAPE: case PARAM_LFO4_SHAPE:
+                    lfos[e->id - PARAM_LFO1_SHAPE].shape = (enum OSC_TYPE)e->value; break;
+                case PARAM_LFO1_RETRIGGER: case PARAM_LFO2_RETRIGGER: case PARAM_LFO3_RETRIGGER: case PARAM_LFO4_RETRIGGER:
+                    lfos[e->id - PARAM_LFO1_RETRIGGER].retrigger = (e->value != 0.0f); break;
+                default : break;
+            }
+        }; break;
+        case EVENT_CC: s->mod.cc[e->id & 0x7F] = e->value; break;
+        // the id of a route holds the source in its top 4 bits and the destination in its bottom 3
+        case EVENT_MOD_ROUTE: mod_route_set(&s->mod, (enum MOD_SOURCE)(e->id >> 3), (enum MOD_DEST)(e->id & 0x7), e->value); break;
+        default : break;
+    }
+}
+
+// renders every note into out for a span of samples which has no events in it
+static inline void synth_render_span(Synth *s, double *out, unsigned int count, double time, double timeStep){
+
+    NoteList *l = &s->notes;
+
+    // For each note currently pressed
+    for(int i = 0; i < l->current; i++){
+        Note *n = &l->notes[i];
+        // add the frequencies and waveforms of each note together to produce polyphony
+        envelope_block(&s->params, &s->kernels, n, s->amp, count, time, timeStep);
+        // silent notes and, when the cpu is struggling, quiet and old notes are rendered with fewer voices
+        int voices = lod_voices(&s->lod, n, s->amp, count, l->current - 1 - i);
+        // notes being modulated are rendered a control block at a time
+        if(mod_active(&s->mod, n))
+            mod_render(&s->mod, &s->params, &s->kernels, n, SYNTH_BLEND, s->amp, out, count, time, timeStep, voices, s->sampleRate);
+        else
+            unison(&s->params, &s->kernels, n, SYNTH_BLEND, 0.0, s->params.modDepth, 0.0, s->amp, out, count, time, timeStep, voices);
+        // if the note is no longer producing sound remove it from the note list
+        if(n->active == false){
+            sampler_release(n);
+            note_remove(l, *n);
+            i--; // the next note has moved into this position, don't skip it
+        }
+    }
+}
+
+/*
+generates a block of samples from a synth into out
+the block is rendered in spans which end where the next event is due so every event is played on
+its own sample, the time of the synth is moved forward to the end of the block
+*/
+static inline void synth_render(Synth *s, double *out, unsigned int count){
+
+    double timeStep = 1.0 / (double)s->sampleRate;
+    memset(out, 0, count * sizeof(double));
+
+    synth_acquire_tuning(s);
+
+    unsigned int done = 0;
+    while(done < count){
+
+        double time = s->time;
+
+        // play every event which is due by this sample
+        SynthEvent e;
+        while(events_next(&s->events, time, &e))
+            synth_apply_event(s, &e);
+
+        unsigned int span = count - done;
+        if(span > SYNTH_SPAN)
+            span = SYNTH_SPAN;
+
+        // end the span on the sample the next event is due
+        double next;
+        if(events_peek(&s->events, &next)){
+            // an event sent after the queue was read above can already be due, play it before rendering
+            if(next <= time)
+                continue;
+            double until = ceil((next - time) / timeStep);
+            if(until < span)
+                span = (unsigned int)until;
+        }
+
+        synth_render_span(s, out + done, span, time, timeStep);
+        done += span;
+        s->time = time + span * timeStep;
+    }
+}
+
+/*
+called by the audio driver for every block, see set_noise_func
+it ties the monotonic clock to the block so timestamped input lands on the right sample and
+times the block so the level of detail can be raised before generating falls behind the
+sound card, offline renders call synth_render directly and always render at full detail
+*/
+static inline void synth_play(void *synth, double *out, unsigned int count){
+
+    Synth *s = synth;
+    double duration = (double)count / (double)s->sampleRate;
+
+    double start = events_now();
+    events_sync_clock(&s->events, s->time, start, duration);
+
+    synth_render(s, out, count);
+
+    lod_update(&s->lod, events_now() - start, duration);
+}
+
+#endif //SYNTH_H
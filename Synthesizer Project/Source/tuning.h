@@ -0,0 +1,278 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <math.h>
+#include "osc.h"
+
+#ifndef TUNING_H
+#define TUNING_H
+
+/*
+this header maps midi keys to frequencies using a tuning table
+the table holds the frequency of every key and the phase increment per sample of that frequency
+at the current sample rate, so nothing has to be calculated with pow() when a note is played.
+
+tables can be generated for 12 tone equal temperament or loaded from a scala file, scala files
+come in two parts, the .scl file describes the scale as a list of pitches in cents or ratios and
+the .kbm file describes how the scale is laid out across the midi keys
+
+a new table is built on the control thread and swapped into a synth atomically (see synth_set_tuning)
+so the audio thread is never stalled while the tuning changes
+*/
+
+#define TUNING_KEYS 128 // the amount of midi keys
+#define TUNING_MAX_DEGREES 1024 // the largest scale that can be loaded from a scala file
+#define TUNING_LINE 256 // the longest line read from a scala file
+
+// structure which holds the frequency and phase increment of every midi key
+typedef struct Tuning{
+    double f[TUNING_KEYS]; // the frequency of each key, 0 if the key isn't mapped
+    double inc[TUNING_KEYS]; // the angular phase increment per sample of each key
+    unsigned int sampleRate; // the sample rate the increments were calculated for
+} Tuning;
+
+// structure which holds the data of a scala keyboard mapping (.kbm)
+typedef struct KeyMap{
+    int size; // the amount of keys before the mapping repeats, 0 maps every key linearly
+    int first; // the first key to be retuned
+    int last; // the last key to be retuned
+    int middle; // the key where the first entry of the mapping is played
+    int reference; // the key the reference frequency is given for
+    double referenceF; // the frequency of the reference key
+    int octaveDegree; // the scale degree the mapping repeats at
+    int map[TUNING_KEYS]; // the scale degree of each key in the mapping, -1 if unmapped
+} KeyMap;
+
+// reads the next line of a scala file which isn't a comment, returns false at the end of the file
+static inline bool scala_next_line(FILE *file, char *line){
+    while(fgets(line, TUNING_LINE, file) != NULL){
+        // lines starting with ! are comments
+        if(line[0] != '!')
+            return true;
+    }
+    return false;
+}
+
+// converts a pitch from a scala file into a frequency ratio, pitches with a '.' are in cents otherwise they are ratios
+static inline bool scala_parse_pitch(const char *line, double *ratio){
+
+    char token[64];
+    if(sscanf(line, " %63s", token) != 1)
+        return false;
+
+    // if the pitch is in cents
+    if(strchr(token, '.') != NULL){
+        *ratio = pow(2.0, atof(token) / 1200.0);
+        return true;
+    }
+
+    // if the pitch is a ratio, a whole number is a ratio over 1
+    long num = 0;
+    long den = 1;
+    int read = sscanf(token, "%ld/%ld", &num, &den);
+    if(read < 1 || num <= 0 || den <= 0)
+        return false;
+
+    *ratio = (double)num / (double)den;
+    return true;
+}
+
+// reads a .scl file into a list of ratios, degrees[0] is always 1 and degrees[count] is the period of the scale
+static inline int scala_load_scale(const char *path, double *degrees){
+
+    FILE *file = fopen(path, "r");
+    if(file == NULL){
+        printf("Tuning Error: Unable to open scale file %s\n", path);
+        return 0;
+    }
+
+    char line[TUNING_LINE];
+    int count = 0;
+
+    // the first line is the description of the scale, the second is the amount of pitches
+    if(!scala_next_line(file, line) || !scala_next_line(file, line) || sscanf(line, "%d", &count) != 1 || count < 1 || count > TUNING_MAX_DEGREES){
+        printf("Tuning Error: %s does not describe a valid scale\n", path);
+        fclose(file);
+        return 0;
+    }
+
+    // the unison isn't written in the file
+    degrees[0] = 1.0;
+    for(int i = 1; i <= count; i++){
+        if(!scala_next_line(file, line) || !scala_parse_pitch(line, &degrees[i])){
+            printf("Tuning Error: Invalid pitch %d in %s\n", i, path);
+            fclose(file);
+            return 0;
+        }
+    }
+
+    fclose(file);
+    return count;
+}
+
+// reads a .kbm file into a keyboard mapping
+static inline bool scala_load_keymap(const char *path, KeyMap *km){
+
+    FILE *file = fopen(path, "r");
+    if(file == NULL){
+        printf("Tuning Error: Unable to open keyboard mapping %s\n", path);
+        return false;
+    }
+
+    char line[TUNING_LINE];
+
+    // the header of the mapping is 7 values on their own lines
+    bool valid = scala_next_line(file, line) && sscanf(line, "%d", &km->size) == 1
+        && scala_next_line(file, line) && sscanf(line, "%d", &km->first) == 1
+        && scala_next_line(file, line) && sscanf(line, "%d", &km->last) == 1
+        && scala_next_line(file, line) && sscanf(line, "%d", &km->middle) == 1
+        && scala_next_line(file, line) && sscanf(line, "%d", &km->reference) == 1
+        && scala_next_line(file, line) && sscanf(line, "%lf", &km->referenceF) == 1
+        && scala_next_line(file, line) && sscanf(line, "%d", &km->octaveDegree) == 1;
+
+    if(!valid || km->size < 0 || km->size > TUNING_KEYS || km->referenceF <= 0.0){
+        printf("Tuning Error: %s does not describe a valid keyboard mapping\n", path);
+        fclose(file);
+        return false;
+    }
+
+    // each entry of the mapping is a scale degree, or x if the key isn't played
+    for(int i = 0; i < km->size; i++){
+        km->map[i] = -1;
+        // missing entries at the end of the file are unmapped
+        if(!scala_next_line(file, line))
+            continue;
+        int degree;
+        if(sscanf(line, "%d", &degree) == 1 && degree >= 0)
+            km->map[i] = degree;
+    }
+
+    fclose(file);
+    return true;
+}
+
+// divide and round towards negative infinity so keys below the middle key land in the octave below
+static inline int tuning_floor_div(int a, int b){
+    int q = a / b;
+    if((a % b != 0) && ((a < 0) != (b < 0)))
+        q--;
+    return q;
+}
+
+// gets the ratio of any scale degree, degrees past the end of the scale are moved up by the period
+static inline double tuning_degree_ratio(const double *degrees, int count, int degree){
+    int octave = tuning_floor_div(degree, count);
+    return degrees[degree - octave * count] * pow(degrees[count], octave);
+}
+
+// gets the ratio of a key relative to the middle key, returns false if the key isn't mapped
+static inline bool tuning_key_ratio(const double *degrees, int count, const KeyMap *km, int key, double *ratio){
+
+    int distance = key - km->middle;
+
+    // a linear mapping plays every degree of the scale in order
+    if(km->size == 0){
+        *ratio = tuning_degree_ratio(degrees, count, distance);
+        return true;
+    }
+
+    // otherwise the mapping repeats every size keys, moving up by the octave degree each time
+    int octave = tuning_floor_div(distance, km->size);
+    int degree = km->map[distance - octave * km->size];
+    if(degree < 0)
+        return false;
+
+    *ratio = tuning_degree_ratio(degrees, count, degree) * pow(tuning_degree_ratio(degrees, count, km->octaveDegree), octave);
+    return true;
+}
+
+// calculates the phase increment of every key from its frequency at the sample rate
+static inline void tuning_fill_inc(Tuning *t, unsigned int sampleRate){
+    t->sampleRate = sampleRate;
+    for(int i = 0; i < TUNING_KEYS; i++){
+        t->inc[i] = toAng(t->f[i]) / (double)sampleRate;
+    }
+}
+
+// creates a 12 tone equal temperament table with A4 at the given frequency
+static inline Tuning* tuning_create_tet(double a4, unsigned int sampleRate){
+
+    Tuning *t = malloc(sizeof(Tuning));
+    if(t == NULL)
+        return NULL;
+
+    for(int i = 0; i < TUNING_KEYS; i++){
+        t->f[i] = a4 * pow(2, ((double)i - 69) / 12);
+    }
+    tuning_fill_inc(t, sampleRate);
+
+    return t;
+}
+
+// creates a table from a scala scale, kbmPath can be NULL to map the scale linearly from middle C with A4 at 440hz
+static inline Tuning* tuning_create_scala(const char *sclPath, const char *kbmPath, unsigned int sampleRate){
+
+    double *degrees = malloc((TUNING_MAX_DEGREES + 1) * sizeof(double));
+    if(degrees == NULL){
+        printf("Tuning Error: Unable to allocate the scale\n");
+        return NULL;
+    }
+    int count = scala_load_scale(sclPath, degrees);
+    if(count == 0){
+        free(degrees);
+        return NULL;
+    }
+
+    // the default mapping used by scala when no .kbm file is given
+    KeyMap km;
+    km.size = 0;
+    km.first = 0;
+    km.last = TUNING_KEYS - 1;
+    km.middle = 60;
+    km.reference = 69;
+    km.referenceF = 440.0;
+    km.octaveDegree = count;
+
+    if(kbmPath != NULL && !scala_load_keymap(kbmPath, &km)){
+        free(degrees);
+        return NULL;
+    }
+
+    // every frequency is calculated relative to the reference key
+    double referenceRatio;
+    if(!tuning_key_ratio(degrees, count, &km, km.reference, &referenceRatio)){
+        printf("Tuning Error: The reference key %d is not mapped\n", km.reference);
+        free(degrees);
+        return NULL;
+    }
+
+    Tuning *t = malloc(sizeof(Tuning));
+    if(t == NULL){
+        printf("Tuning Error: Unable to allocate the tuning table\n");
+        free(degrees);
+        return NULL;
+    }
+
+    for(int i = 0; i < TUNING_KEYS; i++){
+        double ratio;
+        // keys outside of the mapping are silent
+        if(i < km.first || i > km.last || !tuning_key_ratio(degrees, count, &km, i, &ratio))
+            t->f[i] = 0.0;
+        else
+            t->f[i] = km.referenceF * ratio / referenceRatio;
+    }
+    tuning_fill_inc(t, sampleRate);
+
+    free(degrees);
+    return t;
+}
+
+// gets the frequency and phase increment of a key from the same table
+static inline void tuning_key(const Tuning *t, char key, double *f, double *inc){
+    *f = t->f[key & 0x7F];
+    *inc = t->inc[key & 0x7F];
+}
+
+#endif //TUNING_H
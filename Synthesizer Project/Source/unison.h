@@ -1,4 +1,8 @@
 #include "modulate.h"
+#include "params.h"
+#include "note.h"
+#include "sampler.h"
+#include "kernels.h"
 
 #ifndef UNISON_H
 #define UNISON_H
@@ -8,48 +12,125 @@ This header is used to apply Unison to a wave
 Unison is when multiple of the same waves (called voices) are played at the same time
 with a slight detuning between them, this causes the sound to appear fuller and with
 a slight deviation in volime over time
+
+the detuned phase increment of each voice is calculated once when the note is turned on
+so the voices only have to be stepped forward for each block
+*/
+
+// gets how far a voice is detuned from the note in hz, for more than one voice they are spread evenly across +/- the detune value
+static inline double unison_offset(int voice, int voices, double detune){
+    if(voices < 2)
+        return 0.0;
+    return -detune + (voice + 1) * ((2 * detune) / (voices - 1));
+}
+
+/*
+picks which voices of a note are rendered when only some of them are, the voices detuned least
+from the key are kept first so leaving voices out doesn't move the pitch of the note, the spread
+isn't centred on the key so these aren't always the first voices
+*/
+static inline void unison_pick(int voices, int rendered, bool *render){
+    for(int i = 0; i < voices; i++)
+        render[i] = (rendered >= voices);
+    if(rendered >= voices)
+        return;
+
+    // the order only depends on the amount of voices, any detune scales every offset by the same amount
+    for(int k = 0; k < rendered; k++){
+        int nearest = -1;
+        for(int i = 0; i < voices; i++){
+            if(!render[i] && (nearest < 0 || fabs(unison_offset(i, voices, 1.0)) < fabs(unison_offset(nearest, voices, 1.0))))
+                nearest = i;
+        }
+        render[nearest] = true;
+    }
+}
+
+// calculates the phase increment of every voice of a note from the increment of its key, time is when the note is turned on
+static inline void unison_prepare(Note *n, double keyInc, double detune, int voices, double time, unsigned int sampleRate){
+
+    // keep the voice count within the space held by the note
+    if(voices < 1)
+        voices = 1;
+    if(voices > NOTE_MAX_VOICES)
+        voices = NOTE_MAX_VOICES;
+    n->voices = voices;
+    n->keyInc = keyInc;
+    n->detune = detune;
+
+    for(int i = 0; i < voices; i++){
+        double offset = unison_offset(i, voices, detune);
+
+        n->inc[i] = keyInc + toAng(offset) / (double)sampleRate;
+        // start the voice at the phase it would have at this time so retriggered notes don't click
+        n->phase[i] = fmod(toAng(n->f + offset) * time, OSC_PERIOD);
+    }
+}
+
+/*
+adds a block of rendered unison voices of a note to out, see unison_pick, amp holds the volume of each sample
+and time is the global time of the first sample
+blend and depth are their values at the first sample and ramp by their steps every sample, the
+modulation matrix ramps them across each control block and everything else holds them with a step of 0
+the oscillators are run by the kernels, samples and noise can't be vectorized so they are
+generated a sample at a time
+
+the voices which aren't rendered are only stepped forward, the rendered voices are made louder to
+make up for them so leaving voices out changes the thickness of a note but not its volume
 */
-double unison(double detune, int voices, double f, double blend, double volume){
-    
-    // instantiate sample return value
-    double r = 0.0;
-    
+static inline void unison(const SynthParams *p, const Kernels *k, Note *n, double blend, double blendStep, double depth, double depthStep,
+            const double *amp, double *out, unsigned int count, double time, double timeStep, int rendered){
+
+    // for an odd amount of voices the centre/first voice isn't blended, for an even amount the two centre voices aren't
+    int mainVoices = (n->voices % 2 == 1) ? 1 : 2;
+
+    bool render[NOTE_MAX_VOICES];
+    unison_pick(n->voices, rendered, render);
+
+    // the detuned voices add up by their power, so compare the power of every voice to the power of the rendered voices
+    // a ramped blend is compared at the middle of the block
+    double midBlend = blend + blendStep * (count - 1) * 0.5;
+    double full = 0.0;
+    double part = 0.0;
+    for(int i = 0; i < n->voices; i++){
+        double power = (i < mainVoices) ? 1.0 : midBlend * midBlend;
+        full += power;
+        part += render[i] ? power : 0.0;
+    }
+    double makeUp = (rendered < n->voices && part > 0.0) ? sqrt(full / part) : 1.0;
+
     // for every voice
-    for(int i = 1; i <= voices; i++){
-        // if there is only one voice
-        if(voices == 1){
-            return modulate(f, f, modDepth, volume); // return only one wave with no detuning
+    for(int i = 0; i < n->voices; i++){
+        // for the main voices there is no volume dampening, for the others dampen the volume, then normalize by the amount of voices
+        double weight = ((i < mainVoices) ? 1.0 : blend) / n->voices * makeUp;
+        double weightStep = (i < mainVoices) ? 0.0 : blendStep / n->voices * makeUp;
+
+        // voices which aren't rendered are stepped forward so they are in place when they are rendered again
+        if(!render[i]){
+            if(n->zone >= 0)
+                n->pos[i] += count * n->step[i];
         }
-        // if there is more than one voice
-        else{
-            double newf = (f - detune) + i*((2 * detune) / (voices - 1)); // deviate a frequency +/- detune value
-            
-            // for the first one or two voices there is no volume dampening
-            double detunedMain = modulate(newf, newf, modDepth, volume);
-            // for the other voices dampen the volume
-            double detunedSide = modulate(newf, newf, modDepth, volume * blend);
-            
-            // if Odd
-            if(voices % 2 == 1){
-                // if the voice is the centre/first voice
-                if(i == 1)
-                    r += detunedMain; // no blending
-                // if a side voice
-                else
-                    r += detunedSide; // blending
-            }
-            // if Even
-            if(voices % 2 == 0){
-                // if the voice is one of the centre voices
-                if(i == 1 || i == 2)
-                    r += detunedMain; // no blending
-                // if a side voice
-                else
-                    r += detunedSide; // blending
+
+        // samples are played from their own playheads rather than the oscillators
+        else if(p->carrier == OSC_SAMPLE){
+            for(unsigned int j = 0; j < count; j++)
+                out[j] += sampler_read(n, i) * amp[j] * (weight + j * weightStep);
+        }
+        else if(p->carrier == OSC_NOISE || p->mod == OSC_NOISE){
+            double phase = n->phase[i];
+            for(unsigned int j = 0; j < count; j++){
+                out[j] += modulate(p, phase, phase, depth + j * depthStep, amp[j] * (weight + j * weightStep), time + j * timeStep);
+                phase += n->inc[i];
             }
         }
+        else
+            k->voice(out, amp, count, weight, weightStep, n->phase[i], n->inc[i], depth, depthStep, p->carrier, p->mod, time, timeStep);
+
+        // step the voice forward to the next block and keep the phase within one period
+        n->phase[i] = fmod(n->phase[i] + count * n->inc[i], OSC_PERIOD);
+        if(n->phase[i] < 0.0)
+            n->phase[i] += OSC_PERIOD;
     }
-    return r / voices; // return a sample normalized by the amount of voices;
 }
 
 #endif //UNISON_H
@@ -0,0 +1,599 @@
+#define _POSIX_C_SOURCE 200809L // the engine uses posix functions which -std=c11 hides
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <math.h>
+
+/*
+This test renders a fixed set of note and parameter scenarios through the original scalar
+code kept in reference.h, and through the engine in synth.h once for every kernel set the cpu can run.
+the two renders are compared block by block by their largest sample error and their
+signal to noise ratio, any block past the thresholds fails the test.
+
+after the corpus a few behaviours of the engine which the reference doesn't have are checked
+directly against the state of a synth
+
+every kernel set renders on its own synth on its own thread at the same time, so any state
+still shared between synths shows up as a failed comparison
+
+it doesn't use the audio drivers so it can be run headless on any platform, so the level
+of detail is never raised and only silent notes are left out, which has to give the same output
+*/
+
+#define SYNTH_IMPLEMENTATION // the state shared by the engine is defined in this file, see global.h
+#include "../Source/synth.h"
+// the test never opens a midi device, so it is built without ALSA even where test.sh can't check for the headers
+#ifndef SYNTH_NO_ALSA
+#define SYNTH_NO_ALSA
+#endif
+#include "../Source/midi.h"
+#include "reference.h"
+
+#define TEST_SAMPLE_RATE 44100
+#define TEST_BLOCK 1024 // the size of the blocks the engine renders and the renders are compared in
+#define TEST_MAX_EVENTS 8
+#define TEST_MAX_MIDI 16 // the most bytes in a midi stream checked by the parser
+#define MAX_ERROR 1e-6 // the largest difference allowed between any two samples
+#define MIN_SNR 100.0 // the lowest signal to noise ratio allowed in a block, in dB
+#define MAX_RAMP_ERROR 0.001 // how far a route ramped across control blocks can be from one worked out every sample
+
+// a note being turned on or off at a time in seconds
+typedef struct TestEvent{
+    double time;
+    char key;
+    bool on;
+} TestEvent;
+
+// the parameters and notes played during one render
+typedef struct Scenario{
+    const char *name;
+    enum OSC_TYPE carrier;
+    enum OSC_TYPE mod;
+    double modDepth;
+    double detune;
+    int voices;
+    double attack, decay, sustain, release, peak;
+    double length; // how long the scenario is rendered for in seconds
+    int eventNum;
+    TestEvent events[TEST_MAX_EVENTS];
+} Scenario;
+
+/*
+noise is left out of the corpus as it is random, and the original unison calls the
+oscillator twice per voice so the two paths don't use the random numbers in the same order
+
+the envelopes are chosen so the 0.001 cut off isn't crossed exactly on a sample, where
+rounding in the time could put the two paths on either side of it
+*/
+Scenario corpus[] = {
+    { "single sine", OSC_SINE, OSC_SINE, 0.0, 0.0, 1, 0.1, 0.2, 0.5, 0.3, 0.8, 2.0,
+        2, { {0.0, 69, true}, {1.2, 69, false} } },
+    { "detuned chord", OSC_SINE, OSC_SINE, 0.0, 1.4, 5, 0.05, 0.3, 0.3, 0.5, 0.3, 3.0,
+        6, { {0.0, 60, true}, {0.01, 64, true}, {0.02, 67, true}, {2.0, 60, false}, {2.1, 64, false}, {2.2, 67, false} } },
+    { "even unison", OSC_SINE, OSC_SINE, 0.0, 2.0, 4, 0.02, 0.1, 0.6, 0.4, 0.5, 2.0,
+        2, { {0.0, 57, true}, {1.5, 57, false} } },
+    { "fm triangle", OSC_SINE, OSC_TRIANGLE, 2.5, 0.8, 5, 0.01, 0.2, 0.4, 0.3, 0.4, 2.0,
+        4, { {0.0, 72, true}, {0.3, 48, true}, {1.5, 72, false}, {1.6, 48, false} } },
+    { "triangle carrier", OSC_TRIANGLE, OSC_SINE, 0.7, 0.4, 3, 0.2, 0.2, 0.3, 0.2, 0.5, 2.0,
+        2, { {0.0, 81, true}, {1.4, 81, false} } },
+    { "square carrier", OSC_SQUARE, OSC_SINE, 0.3, 0.6, 5, 0.05, 0.1, 0.5, 0.2, 0.5, 2.0,
+        2, { {0.5, 64, true}, {1.5, 64, false} } },
+    { "released in attack", OSC_SINE, OSC_SINE, 1.0, 1.0, 5, 1.0, 0.5, 0.3, 0.6, 0.37, 2.0,
+        2, { {0.0, 62, true}, {0.4, 62, false} } },
+    { "retrigger", OSC_SINE, OSC_SQUARE, 0.5, 0.9, 5, 0.1, 0.2, 0.4, 0.8, 0.4, 3.0,
+        4, { {0.0, 65, true}, {0.7, 65, false}, {1.0, 65, true}, {2.0, 65, false} } },
+    { "extreme keys", OSC_SINE, OSC_SINE, 0.2, 3.0, 5, 0.01, 0.1, 0.5, 0.2, 0.3, 2.0,
+        4, { {0.0, 21, true}, {0.0, 108, true}, {1.5, 21, false}, {1.5, 108, false} } },
+};
+
+// a render of a scenario through the engine with one kernel set, run on its own thread
+typedef struct EngineRun{
+    const Scenario *scenario;
+    const Kernels *set;
+    double *out;
+    int length;
+    pthread_t thread;
+} EngineRun;
+
+// sets the parameters of the reference
+void set_params(const Scenario *s){
+    carrier = s->carrier;
+    mod = s->mod;
+    modDepth = s->modDepth;
+    detune = s->detune;
+    attackTime = s->attack;
+    decayTime = s->decay;
+    sustainAmp = s->sustain;
+    releaseTime = s->release;
+    peak = s->peak;
+}
+
+// sets the same parameters on a synth
+void set_synth_params(Synth *synth, const Scenario *s){
+    synth->params.carrier = s->carrier;
+    synth->params.mod = s->mod;
+    synth->params.modDepth = s->modDepth;
+    synth->params.detune = s->detune;
+    synth->params.unisonVoices = s->voices;
+    synth->params.attackTime = s->attack;
+    synth->params.decayTime = s->decay;
+    synth->params.sustainAmp = s->sustain;
+    synth->params.releaseTime = s->release;
+    synth->params.peak = s->peak;
+}
+
+/*
+events are moved half a sample later so both paths agree on which sample they land on,
+the reference adds up the time a sample at a time and the engine a block at a time, so
+an event exactly on a sample could land either side of it
+*/
+double event_time(const TestEvent *e){
+    return e->time + 0.5 / TEST_SAMPLE_RATE;
+}
+
+// renders a scenario through the reference a sample at a time, the same way the audio thread used to
+void render_reference(const Scenario *s, double *out, int length){
+
+    set_params(s);
+    srand(1);
+    ref_notes_init(9);
+
+    globalTime = 0;
+    double timeStep = 1.0 / (double)TEST_SAMPLE_RATE;
+
+    int next = 0;
+    for(int i = 0; i < length; i++){
+        // play every event which is due before this sample
+        while(next < s->eventNum && event_time(&s->events[next]) <= globalTime){
+            s->events[next].on ? ref_note_on(s->events[next].key) : ref_note_off(s->events[next].key);
+            next++;
+        }
+
+        out[i] = ref_generate_wave(s->voices);
+        globalTime = globalTime + timeStep;
+    }
+}
+
+// renders a scenario through a new synth in blocks, with the notes sent through the event queue like any other input
+void *render_engine(void *args){
+
+    EngineRun *run = args;
+    const Scenario *s = run->scenario;
+
+    Synth *synth = synth_create(TEST_SAMPLE_RATE, 9);
+    if(synth == NULL){
+        printf("Unable to create a synth\n");
+        exit(1);
+    }
+    synth->kernels = *run->set;
+    set_synth_params(synth, s);
+
+    for(int i = 0; i < s->eventNum; i++){
+        SynthEvent e;
+        e.time = event_time(&s->events[i]);
+        e.type = s->events[i].on ? EVENT_NOTE_ON : EVENT_NOTE_OFF;
+        e.id = s->events[i].key;
+        e.value = 0.0f;
+        synth_send(synth, &e, 1);
+    }
+
+    for(int i = 0; i < run->length; i += TEST_BLOCK){
+        int count = (i + TEST_BLOCK < run->length) ? TEST_BLOCK : run->length - i;
+        synth_render(synth, run->out + i, count);
+    }
+
+    synth_destroy(synth);
+    return NULL;
+}
+
+// compares the two renders of a scenario, returns false if any block is past the thresholds
+bool compare(const Scenario *s, const char *set, const double *expected, const double *actual, int length){
+
+    double worstError = 0.0;
+    double worstSnr = INFINITY;
+    bool pass = true;
+
+    for(int start = 0; start < length; start += TEST_BLOCK){
+
+        int end = (start + TEST_BLOCK < length) ? start + TEST_BLOCK : length;
+        double maxError = 0.0;
+        double signal = 0.0;
+        double noise = 0.0;
+
+        for(int i = start; i < end; i++){
+            double error = actual[i] - expected[i];
+            maxError = fmax(maxError, fabs(error));
+            signal += expected[i] * expected[i];
+            noise += error * error;
+        }
+
+        // silent blocks only have to match by their error
+        double snr = (noise > 0.0 && signal > 1e-12) ? 10.0 * log10(signal / noise) : INFINITY;
+
+        if(maxError > MAX_ERROR || snr < MIN_SNR){
+            if(pass)
+                printf("  %s %s: block %d failed, max error %g, SNR %.1f dB\n", set, s->name, start / TEST_BLOCK, maxError, snr);
+            pass = false;
+        }
+
+        worstError = fmax(worstError, maxError);
+        worstSnr = fmin(worstSnr, snr);
+    }
+
+    printf("%s %-8s %-20s max error %-12g min SNR %.1f dB\n", pass ? "PASS" : "FAIL", set, s->name, worstError, worstSnr);
+    return pass;
+}
+
+// prints the result of a check of the engine
+bool check_result(const char *name, bool pass){
+    printf("%s %s\n", pass ? "PASS" : "FAIL", name);
+    return pass;
+}
+
+// an event sent far ahead of time mustn't hold back events sent after it which are due sooner
+bool check_event_order(){
+
+    Synth *synth = synth_create(TEST_SAMPLE_RATE, 9);
+    SynthEvent e[2] = {
+        { 1.0, EVENT_NOTE_ON, 60, 0.0f },
+        { 0.01, EVENT_NOTE_ON, 64, 0.0f }
+    };
+    // sent as two batches the way two clients would send them
+    synth_send(synth, &e[0], 1);
+    synth_send(synth, &e[1], 1);
+
+    double *out = malloc(TEST_BLOCK * sizeof(double));
+    for(int i = 0; i < 20; i++)
+        synth_render(synth, out, TEST_BLOCK);
+    free(out);
+
+    bool pass = synth->notes.current == 1 && synth->notes.notes[0].id == 64;
+    synth_destroy(synth);
+    return check_result("events out of order", pass);
+}
+
+/*
+a note whose pitch route is removed has to go back to its unmodulated pitch, the route is removed on
+a sample where the block which ramps it back to 0 is the last control block of a span
+*/
+bool check_route_removed(){
+
+    Synth *modulated = synth_create(TEST_SAMPLE_RATE, 9);
+    Synth *plain = synth_create(TEST_SAMPLE_RATE, 9);
+    SynthEvent e[3] = {
+        { 0.0, EVENT_MOD_ROUTE, (MOD_SRC_VELOCITY << 3) | MOD_DEST_PITCH, 12.0f },
+        { 0.01, EVENT_NOTE_ON, 69, 0.0f },
+        { 20470.0 / TEST_SAMPLE_RATE, EVENT_MOD_ROUTE, (MOD_SRC_VELOCITY << 3) | MOD_DEST_PITCH, 0.0f }
+    };
+    synth_send(modulated, e, 3);
+    synth_send(plain, &e[1], 1);
+
+    double *out = malloc(TEST_BLOCK * sizeof(double));
+    for(int i = 0; i < 40; i++){
+        synth_render(modulated, out, TEST_BLOCK);
+        synth_render(plain, out, TEST_BLOCK);
+    }
+    free(out);
+
+    bool pass = modulated->notes.current == 1 && plain->notes.current == 1;
+    for(int i = 0; pass && i < plain->notes.notes[0].voices; i++)
+        pass = modulated->notes.notes[0].inc[i] == plain->notes.notes[0].inc[i];
+
+    synth_destroy(modulated);
+    synth_destroy(plain);
+    return check_result("pitch route removed", pass);
+}
+
+// an offline render has to play a note sent for the very start of the synth
+bool check_note_at_start(){
+
+    Synth *synth = synth_create(TEST_SAMPLE_RATE, 9);
+    SynthEvent e = { 0.0, EVENT_NOTE_ON, 69, 0.0f };
+    synth_send(synth, &e, 1);
+
+    double *out = malloc(TEST_BLOCK * sizeof(double));
+    double loudest = 0.0;
+    for(int i = 0; i < 43; i++){
+        synth_render(synth, out, TEST_BLOCK);
+        for(int j = 0; j < TEST_BLOCK; j++)
+            loudest = fmax(loudest, fabs(out[j]));
+    }
+    free(out);
+
+    bool pass = loudest > 0.01 && synth->notes.current == 1;
+    synth_destroy(synth);
+    return check_result("note at time 0", pass);
+}
+
+// a note turned off and on again at the same time, as one read from a midi device can be, has to be held and heard
+bool check_same_time_retrigger(){
+
+    Synth *synth = synth_create(TEST_SAMPLE_RATE, 9);
+    SynthEvent e[3] = {
+        { 0.1, EVENT_NOTE_ON, 60, 0.0f },
+        { 0.5, EVENT_NOTE_OFF, 60, 0.0f },
+        { 0.5, EVENT_NOTE_ON, 60, 0.0f }
+    };
+    synth_send(synth, e, 3);
+
+    // render past the second note on, then for a second after it
+    double *out = malloc(TEST_BLOCK * sizeof(double));
+    double loudest = 0.0;
+    for(int i = 0; i < 65; i++){
+        synth_render(synth, out, TEST_BLOCK);
+        for(int j = 0; i >= 22 && j < TEST_BLOCK; j++)
+            loudest = fmax(loudest, fabs(out[j]));
+    }
+    free(out);
+
+    bool pass = loudest > 0.01 && synth->notes.current == 1 && !synth->notes.notes[0].released;
+    synth_destroy(synth);
+    return check_result("same time retrigger", pass);
+}
+
+// a stream of midi bytes and the messages the parser has to read from it
+typedef struct MidiCase{
+    const char *name;
+    int size;
+    unsigned char bytes[TEST_MAX_MIDI];
+    int msgNum;
+    uint32_t msgs[TEST_MAX_MIDI];
+} MidiCase;
+
+MidiCase midiCases[] = {
+    { "midi running status", 5, { 0x90, 60, 100, 64, 100 },
+        2, { 0x90 | 60 << 8 | 100 << 16, 0x90 | 64 << 8 | 100 << 16 } },
+    { "midi real time bytes in a message", 5, { 0x90, 0xF8, 62, 0xFE, 90 },
+        1, { 0x90 | 62 << 8 | 90 << 16 } },
+    { "midi sysex dropped", 9, { 0xF0, 0x7E, 0x01, 0x02, 0xF7, 0x03, 0x90, 65, 80 },
+        1, { 0x90 | 65 << 8 | 80 << 16 } },
+    { "midi one byte messages", 8, { 0xC0, 5, 6, 0xD0, 40, 0xB0, 1, 127 },
+        4, { 0xC0 | 5 << 8, 0xC0 | 6 << 8, 0xD0 | 40 << 8, 0xB0 | 1 << 8 | 127 << 16 } },
+};
+
+// every message read from each stream has to match, byte for byte
+bool check_midi_parser(){
+
+    bool pass = true;
+    for(int i = 0; i < (int)(sizeof(midiCases) / sizeof(midiCases[0])); i++){
+        const MidiCase *c = &midiCases[i];
+        MidiParser parser = { 0, { 0, 0 }, 0 };
+        int msgNum = 0;
+        bool matched = true;
+
+        for(int j = 0; j < c->size; j++){
+            uint32_t msg;
+            if(midi_parse_byte(&parser, c->bytes[j], &msg)){
+                matched = matched && msgNum < c->msgNum && msg == c->msgs[msgNum];
+                msgNum++;
+            }
+        }
+
+        pass = check_result(c->name, matched && msgNum == c->msgNum) && pass;
+    }
+    return pass;
+}
+
+// midi messages have to reach the queue as the right events, a note on with no velocity releases the note
+bool check_midi_events(){
+
+    Synth *synth = synth_create(TEST_SAMPLE_RATE, 9);
+    uint32_t msgs[4] = {
+        0x90 | 60 << 8 | 127 << 16,
+        0x90 | 60 << 8,
+        0x80 | 62 << 8 | 64 << 16,
+        0xB0 | 1 << 8 | 127 << 16
+    };
+    for(int i = 0; i < 4; i++)
+        midi_handle(synth, msgs[i], 0.0);
+
+    SynthEvent expected[4] = {
+        { 0.0, EVENT_NOTE_ON, 60, 1.0f },
+        { 0.0, EVENT_NOTE_OFF, 60, 0.0f },
+        { 0.0, EVENT_NOTE_OFF, 62, 64 / 127.0f },
+        { 0.0, EVENT_CC, 1, 1.0f }
+    };
+    SynthEvent e;
+    int eventNum = 0;
+    bool pass = true;
+    while(events_next(&synth->events, 0.0, &e)){
+        pass = pass && eventNum < 4 && e.type == expected[eventNum].type && e.id == expected[eventNum].id
+            && e.value == expected[eventNum].value;
+        eventNum++;
+    }
+
+    synth_destroy(synth);
+    return check_result("midi messages to events", pass && eventNum == 4);
+}
+
+// renders a detuned note with a number of voices at a level of detail
+void render_detail(int voices, int level, double *out, int length){
+
+    Synth *synth = synth_create(TEST_SAMPLE_RATE, 9);
+    synth->params.detune = 2.0;
+    synth->params.unisonVoices = voices;
+    synth->params.attackTime = 0.01;
+    atomic_store(&synth->lod.level, level);
+
+    SynthEvent e = { 0.0, EVENT_NOTE_ON, 69, 0.0f };
+    synth_send(synth, &e, 1);
+    for(int i = 0; i < length; i += TEST_BLOCK)
+        synth_render(synth, out + i, TEST_BLOCK);
+
+    synth_destroy(synth);
+}
+
+/*
+a note reduced to its centre voice by the level of detail has to keep the pitch of the note, the voice
+left has to be the one tuned to the key, which is the same wave as a note with one voice at another volume
+*/
+bool check_reduced_pitch(){
+
+    int length = 44 * TEST_BLOCK;
+    double *reduced = malloc(length * sizeof(double));
+    double *single = malloc(length * sizeof(double));
+    render_detail(5, LOD_MAX_LEVEL, reduced, length);
+    render_detail(1, 0, single, length);
+
+    // the volume of the reduced note relative to the single voice, then how far it is from that
+    double dot = 0.0;
+    double power = 0.0;
+    for(int i = 0; i < length; i++){
+        dot += reduced[i] * single[i];
+        power += single[i] * single[i];
+    }
+    double scale = dot / power;
+    double error = 0.0;
+    for(int i = 0; i < length; i++)
+        error = fmax(error, fabs(reduced[i] - scale * single[i]));
+
+    free(reduced);
+    free(single);
+    return check_result("reduced note keeps its pitch", power > 0.0 && error <= MAX_ERROR);
+}
+
+// writes a scala file for a check into the working directory
+bool write_file(const char *path, const char *text){
+    FILE *file = fopen(path, "w");
+    if(file == NULL)
+        return false;
+    fputs(text, file);
+    fclose(file);
+    return true;
+}
+
+// a 12 step scale in cents has to give the same table as 12-TET, written in cents to go through the cents parser
+bool check_scala_edo(){
+
+    const char *scl = "! equivalence_edo.scl\n12 equal divisions of the octave\n 12\n!\n"
+        "100.0\n200.0\n300.0\n400.0\n500.0\n600.0\n700.0\n800.0\n900.0\n1000.0\n1100.0\n2/1\n";
+
+    bool pass = write_file("equivalence_edo.scl", scl);
+    Tuning *scala = pass ? tuning_create_scala("equivalence_edo.scl", NULL, TEST_SAMPLE_RATE) : NULL;
+    Tuning *tet = tuning_create_tet(440.0, TEST_SAMPLE_RATE);
+    remove("equivalence_edo.scl");
+
+    pass = scala != NULL;
+    for(int i = 0; pass && i < TUNING_KEYS; i++)
+        pass = fabs(scala->f[i] - tet->f[i]) <= 1e-9 * tet->f[i] && fabs(scala->inc[i] - tet->inc[i]) <= 1e-9 * tet->inc[i];
+
+    free(scala);
+    free(tet);
+    return check_result("scala 12 edo matches 12-TET", pass);
+}
+
+/*
+a 5 limit just scale mapped to the white keys, with the black keys left out by x entries
+A4 is 440hz on the 6th degree (5/3) so middle C is 264hz, its octave 528hz and G 396hz
+*/
+bool check_scala_keymap(){
+
+    const char *scl = "! equivalence_just.scl\n5 limit major scale\n7\n!\n9/8\n5/4\n4/3\n3/2\n5/3\n15/8\n2/1\n";
+    const char *kbm = "! equivalence_white.kbm\n! size\n12\n! first and last key\n0\n127\n! middle key\n60\n"
+        "! reference key and frequency\n69\n440.0\n! octave degree\n7\n! mapping\n0\nx\n1\nx\n2\n3\nx\n4\nx\n5\nx\n6\n";
+
+    bool pass = write_file("equivalence_just.scl", scl) && write_file("equivalence_white.kbm", kbm);
+    Tuning *t = pass ? tuning_create_scala("equivalence_just.scl", "equivalence_white.kbm", TEST_SAMPLE_RATE) : NULL;
+    remove("equivalence_just.scl");
+    remove("equivalence_white.kbm");
+
+    pass = t != NULL && fabs(t->f[60] - 264.0) <= 1e-9 && t->f[61] == 0.0 && fabs(t->f[67] - 396.0) <= 1e-9
+        && fabs(t->f[69] - 440.0) <= 1e-9 && fabs(t->f[72] - 528.0) <= 1e-9;
+
+    free(t);
+    return check_result("scala keyboard mapping", pass);
+}
+
+// renders a note with a fast LFO routed to a destination, evaluating the matrix every rate samples
+void render_lfo_route(enum MOD_DEST dest, double amount, unsigned int rate, double *out, int length){
+
+    Synth *synth = synth_create(TEST_SAMPLE_RATE, 9);
+    synth->params.attackTime = 0.01;
+    synth->params.detune = 1.0;
+    synth->params.modDepth = 1.0;
+    mod_set_rate(&synth->mod, rate);
+    synth->mod.lfos[0].rate = 30.0;
+    mod_route_set(&synth->mod, MOD_SRC_LFO1, dest, amount);
+
+    SynthEvent e = { 0.001, EVENT_NOTE_ON, 69, 0.0f };
+    synth_send(synth, &e, 1);
+    for(int i = 0; i < length; i += TEST_BLOCK)
+        synth_render(synth, out + i, TEST_BLOCK);
+
+    synth_destroy(synth);
+}
+
+// the fm depth and blend have to ramp across each control block rather than step between them
+bool check_ramped_routes(){
+
+    int length = 44 * TEST_BLOCK;
+    double *exact = malloc(length * sizeof(double));
+    double *ramped = malloc(length * sizeof(double));
+    bool pass = true;
+
+    enum MOD_DEST dests[2] = { MOD_DEST_FM_DEPTH, MOD_DEST_BLEND };
+    double amounts[2] = { 1.0, 0.4 };
+    for(int d = 0; d < 2; d++){
+        render_lfo_route(dests[d], amounts[d], 1, exact, length);
+        render_lfo_route(dests[d], amounts[d], MOD_DEFAULT_RATE, ramped, length);
+        for(int i = 0; i < length; i++)
+            pass = pass && fabs(exact[i] - ramped[i]) <= MAX_RAMP_ERROR;
+    }
+
+    free(exact);
+    free(ramped);
+    return check_result("fm depth and blend ramps", pass);
+}
+
+int main(){
+
+    kernels_init();
+
+    int failed = 0;
+    int runs = 0;
+    int scenarioNum = sizeof(corpus) / sizeof(corpus[0]);
+
+    for(int i = 0; i < scenarioNum; i++){
+        int length = (int)(corpus[i].length * TEST_SAMPLE_RATE);
+        double *expected = malloc(length * sizeof(double));
+
+        render_reference(&corpus[i], expected, length);
+
+        // every kernel set this cpu can run renders at once and has to match the reference
+        EngineRun engineRuns[KERNEL_MAX_SETS];
+        for(int j = 0; j < kernelSetNum; j++){
+            engineRuns[j].scenario = &corpus[i];
+            engineRuns[j].set = &kernelSets[j];
+            engineRuns[j].out = malloc(length * sizeof(double));
+            engineRuns[j].length = length;
+            if(pthread_create(&engineRuns[j].thread, NULL, &render_engine, &engineRuns[j]) != 0){
+                printf("Unable to start a render thread\n");
+                return 1;
+            }
+        }
+
+        for(int j = 0; j < kernelSetNum; j++){
+            pthread_join(engineRuns[j].thread, NULL);
+            if(!compare(&corpus[i], kernelSets[j].name, expected, engineRuns[j].out, length))
+                failed++;
+            runs++;
+            free(engineRuns[j].out);
+        }
+
+        free(expected);
+    }
+
+    bool (*checks[])() = { check_event_order, check_route_removed, check_ramped_routes, check_same_time_retrigger, check_note_at_start,
+        check_midi_parser, check_midi_events, check_scala_edo, check_scala_keymap,
+        check_reduced_pitch };
+    for(int i = 0; i < (int)(sizeof(checks) / sizeof(checks[0])); i++){
+        if(!checks[i]())
+            failed++;
+        runs++;
+    }
+
+    printf("%d of %d runs passed\n", runs - failed, runs);
+    return (failed == 0) ? 0 : 1;
+}
@@ -0,0 +1,189 @@
+#include <stdatomic.h>
+#include "../Source/note.h"
+#include "../Source/osc.h"
+
+#ifndef REFERENCE_H
+#define REFERENCE_H
+
+/*
+this header holds the original scalar versions of osc, modulate, unison, envelope_apply and
+the note list, they are kept exactly as they were written so the optimized engine can be
+checked against them, do not optimize anything in this file
+
+the original code read its time and parameters from globals, the engine now keeps them in
+each synth so they are defined here, the test copies the same settings into both
+*/
+
+_Atomic double globalTime;
+enum OSC_TYPE carrier;
+enum OSC_TYPE mod;
+double modDepth;
+double detune;
+double attackTime;
+double decayTime;
+double sustainAmp;
+double releaseTime;
+double peak;
+
+// the reference note list is seperate from the engine's so both can be rendered side by side
+Note refNotes[16];
+int refNotesMax;
+int refNotesCurrent;
+
+double ref_osc(enum OSC_TYPE oscT, double f){
+    switch(oscT){
+        case OSC_SINE: return sin(f);
+        case OSC_SQUARE: return (sin(f) * globalTime > 1) ? 1 : -1;
+        case OSC_TRIANGLE: return asin(sin(f));
+        case OSC_NOISE:
+        if(f != 0)
+            return (2.0 * ((double)rand() / (double)RAND_MAX) - 1.0);
+        else
+            return 0;
+        default : return 0.0;
+    }
+}
+
+double ref_modulate(double cf, double mf, double depth, double v){
+    return ref_osc(carrier, (toAng(cf) * globalTime) + depth * (ref_osc(mod, toAng(mf) * globalTime))) * v;
+}
+
+double ref_unison(double detune, int voices, double f, double blend, double volume){
+
+    double r = 0.0;
+
+    for(int i = 1; i <= voices; i++){
+        if(voices == 1){
+            return ref_modulate(f, f, modDepth, volume);
+        }
+        else{
+            double newf = (f - detune) + i*((2 * detune) / (voices - 1));
+
+            double detunedMain = ref_modulate(newf, newf, modDepth, volume);
+            double detunedSide = ref_modulate(newf, newf, modDepth, volume * blend);
+
+            if(voices % 2 == 1){
+                if(i == 1)
+                    r += detunedMain;
+                else
+                    r += detunedSide;
+            }
+            if(voices % 2 == 0){
+                if(i == 1 || i == 2)
+                    r += detunedMain;
+                else
+                    r += detunedSide;
+            }
+        }
+    }
+    return r / voices;
+}
+
+double ref_envelope_apply(Note *n){
+
+    double returnAmp = 0.0;
+    double releaseAmp = 0.0;
+
+    if(n->on > n->off){
+        double lifetime = globalTime - n->on;
+        if(lifetime <= attackTime){
+            returnAmp = (lifetime / attackTime) * peak;
+        }
+        if(lifetime > attackTime && lifetime <= (decayTime + attackTime)){
+            returnAmp = ((lifetime - attackTime) / decayTime) * (sustainAmp - peak) + peak;
+        }
+        if(lifetime > (attackTime + decayTime)){
+            returnAmp = sustainAmp;
+        }
+    }
+    if(n->off > n->on){
+        double lifetime = n->off - n->on;
+        if(lifetime <= attackTime){
+            releaseAmp = (lifetime / attackTime) * peak;
+        }
+        if(lifetime > attackTime && lifetime <= (decayTime + attackTime)){
+            releaseAmp = ((lifetime - attackTime) / decayTime) * (sustainAmp - peak) + peak;
+        }
+        if(lifetime > (attackTime + decayTime)){
+            releaseAmp = sustainAmp;
+        }
+        returnAmp = ((globalTime - n->off) / releaseTime) * (-releaseAmp) + releaseAmp;
+    }
+
+    if(returnAmp <= 0.001){
+        returnAmp = 0.0;
+        if(n->off > n->on)
+            n->active = false;
+    }
+    return returnAmp;
+}
+
+void ref_notes_init(int max){
+    refNotesMax = max;
+    refNotesCurrent = 0;
+}
+
+Note* ref_note_get(char id){
+    for(int i = 0; i < refNotesCurrent; i++){
+        if(refNotes[i].id == id)
+            return &refNotes[i];
+    }
+    return NULL;
+}
+
+void ref_note_remove(Note n){
+    for(int i = 0; i < refNotesCurrent; i++){
+        if(refNotes[i].id == n.id){
+            for(int j = i; j < refNotesCurrent; j++){
+                refNotes[j] = refNotes[j + 1];
+            }
+            refNotesCurrent--;
+            return;
+        }
+    }
+}
+
+// the note on and off handling from the original MidiInProc, 12-TET at A440
+void ref_note_on(char id){
+    Note *found = ref_note_get(id);
+    if(found == NULL){
+        if(refNotesCurrent < refNotesMax - 1){
+            Note n;
+            n.id = id;
+            n.f = 440 * pow(2, ((double)id - 69) / 12);
+            n.active = true;
+            n.on = globalTime;
+            n.off = 0.0;
+            refNotes[refNotesCurrent] = n;
+            refNotesCurrent++;
+        }
+    }
+    else{
+        found->on = globalTime;
+        found->active = true;
+    }
+}
+
+void ref_note_off(char id){
+    Note *found = ref_note_get(id);
+    if(found != NULL)
+        found->off = globalTime;
+}
+
+/*
+the original generate_wave with unison fixed at 0.4 blend, the original skipped the note after
+a removed note for one sample which the engine no longer does, so that isn't reproduced here
+*/
+double ref_generate_wave(int voices){
+    double r = 0.0;
+    for(int i = 0; i < refNotesCurrent; i++){
+        r += ref_unison(detune, voices, refNotes[i].f, 0.4, ref_envelope_apply(&refNotes[i]));
+        if(refNotes[i].active == false){
+            ref_note_remove(refNotes[i]);
+            i--;
+        }
+    }
+    return r;
+}
+
+#endif //REFERENCE_H
@@ -1,5 +1,5 @@
 @echo off
 if not exist build mkdir build
 pushd build
-gcc ..\source\main.c -o main.exe -lwinmm -std=c11 
+gcc ..\source\main.c -o main.exe -lwinmm -lws2_32 -std=c11 -O3 -fno-trapping-math
 popd
\ No newline at end of file
@@ -0,0 +1,6 @@
+@echo off
+if not exist build mkdir build
+pushd build
+gcc ..\tests\equivalence.c -o equivalence.exe -std=c11 -O3 -fno-trapping-math 
+equivalence.exe
+popd
\ No newline at end of file
@@ -0,0 +1,5 @@
+#!/bin/sh
+mkdir -p build
+cd build
+gcc ../Tests/equivalence.c -o equivalence -std=c11 -O3 -fno-trapping-math -lm -lpthread
+./equivalence